@@ -0,0 +1,190 @@
+#include "bar.h"
+#include "nwm.h"
+#include "profile.h"
+#include "textcache.h"
+#include "window.h"
+#include <X11/Xlib.h>
+#include <X11/Xft/Xft.h>
+#include <cstdio>
+
+#define TEXTW(S) (textWidth(S) + g_windowManager->lrpad)
+
+// Width of text in the bar font, without padding
+int textWidth(const std::string& text) {
+    if (text.empty()) return 0;
+    return shapeText(g_windowManager->font, text).width;
+}
+
+// Fill a box of the back buffer and draw text into it, truncated with an
+// ellipsis to fit the box
+static void drawText(Monitor* m, int x, int w, const std::string& text, int scheme, bool invert) {
+    WindowManager* wm = g_windowManager;
+    XftFont* font = wm->font;
+
+    XSetForeground(wm->display, wm->gc, wm->colors[scheme][invert ? 0 : 1].pixel);
+    XFillRectangle(wm->display, m->barbuf, wm->gc, x, 0, w, wm->bh);
+
+    if (text.empty()) return;
+
+    int ty = (wm->bh - (font->ascent + font->descent)) / 2 + font->ascent;
+    drawTextRun(m->bardraw, &wm->colors[scheme][invert ? 1 : 0], font,
+                x + wm->lrpad / 2, ty, w - wm->lrpad, text);
+}
+
+// Render the tag labels with their occupied and urgent indicators
+static void drawTags(Monitor* m, unsigned int occ, unsigned int urg, unsigned int seltags) {
+    WindowManager* wm = g_windowManager;
+    int boxs = wm->font->ascent / 9;
+    int boxw = wm->font->ascent / 6 + 2;
+    int x = m->barsegs[BarTags].x;
+
+    for (int i = 0; i < NUM_TAGS; i++) {
+        int w = TEXTW(m->tags[i].name);
+        int scheme = (m->tagset & (1u << i)) ? 1 : 0;
+
+        drawText(m, x, w, m->tags[i].name, scheme, urg & (1u << i));
+        if (occ & (1u << i)) {
+            XSetForeground(wm->display, wm->gc, wm->colors[scheme][0].pixel);
+            if (seltags & (1u << i)) {
+                XFillRectangle(wm->display, m->barbuf, wm->gc, x + boxs, boxs, boxw, boxw);
+            } else {
+                XDrawRectangle(wm->display, m->barbuf, wm->gc, x + boxs, boxs, boxw, boxw);
+            }
+        }
+        x += w;
+    }
+}
+
+// Redraw the segments of one bar whose content or position changed and
+// copy the damaged span to the window in one XCopyArea
+void drawBar(Monitor* m) {
+    WindowManager* wm = g_windowManager;
+    Client* sel = wm->getFocusedClient();
+    BarSegment next[BarLast];
+    unsigned int occ = 0, urg = 0, seltags = 0;
+    char buf[64];
+
+    if (!m->showbar || !m->barbuf) return;
+
+    ProfileMark mark = profileBegin();
+    double start = monotonicMs();
+    wm->barStats.frames++;
+
+    if (sel && sel->mon != m) {
+        sel = nullptr;
+    }
+    for (Client* c = m->clients; c; c = c->next) {
+        occ |= c->tags;
+        if (c->isurgent) {
+            urg |= c->tags;
+        }
+    }
+    if (sel) {
+        seltags = sel->tags;
+    }
+
+    // Lay out the segments and fingerprint what each one would show
+    next[BarTags].x = 0;
+    next[BarTags].w = 0;
+    for (int i = 0; i < NUM_TAGS; i++) {
+        next[BarTags].w += TEXTW(m->tags[i].name);
+    }
+    snprintf(buf, sizeof(buf), "%x:%x:%x:%x", m->tagset, occ, urg, seltags);
+    next[BarTags].key = buf;
+
+    next[BarLayout].key = wm->layouts[static_cast<int>(m->tag().layout)].symbol;
+    next[BarLayout].x = next[BarTags].w;
+    next[BarLayout].w = TEXTW(next[BarLayout].key);
+
+    // Only the selected monitor shows the status text
+    if (m == wm->getCurrentMonitor()) {
+        next[BarStatus].key = wm->statusText;
+        next[BarStatus].w = textWidth(wm->statusText) + wm->lrpad / 2 + 2;
+    } else {
+        next[BarStatus].w = 0;
+    }
+    next[BarStatus].x = m->ww - next[BarStatus].w;
+
+    next[BarTitle].x = next[BarLayout].x + next[BarLayout].w;
+    next[BarTitle].w = MAX(next[BarStatus].x - next[BarTitle].x, 0);
+    if (sel) {
+        updateTitle(sel);
+        next[BarTitle].key = titleText(sel->name);
+        next[BarTitle].key += sel->isfloating ? "\x01" : "\x02";
+    }
+
+    // Render only what changed, tracking the damaged span
+    int x1 = m->ww, x2 = 0;
+    for (int s = 0; s < BarLast; s++) {
+        BarSegment& cur = m->barsegs[s];
+        if (cur.x == next[s].x && cur.w == next[s].w && cur.key == next[s].key) {
+            wm->barStats.segmentsSkipped++;
+            continue;
+        }
+
+        switch (s) {
+            case BarTags:
+                drawTags(m, occ, urg, seltags);
+                break;
+            case BarLayout:
+                drawText(m, next[s].x, next[s].w, next[s].key, 0, false);
+                break;
+            case BarTitle:
+                drawText(m, next[s].x, next[s].w, titleText(sel ? sel->name : nullptr), sel ? 1 : 0, false);
+                if (sel && sel->isfloating) {
+                    int boxs = wm->font->ascent / 9;
+                    int boxw = wm->font->ascent / 6 + 2;
+                    XSetForeground(wm->display, wm->gc, wm->colors[1][0].pixel);
+                    XDrawRectangle(wm->display, m->barbuf, wm->gc,
+                                   next[s].x + boxs, boxs, boxw, boxw);
+                }
+                break;
+            case BarStatus:
+                drawText(m, next[s].x, next[s].w, next[s].key, 0, false);
+                break;
+        }
+        wm->barStats.segmentsDrawn++;
+
+        // A segment that shrank or moved leaves stale pixels in its old box
+        x1 = MIN(x1, MIN(cur.x, next[s].x));
+        x2 = MAX(x2, MAX(cur.x + cur.w, next[s].x + next[s].w));
+        cur = next[s];
+    }
+
+    if (x1 < x2) {
+        x1 = MAX(x1, 0);
+        x2 = MIN(x2, m->ww);
+        XCopyArea(wm->display, m->barbuf, m->barwin, wm->gc, x1, 0, x2 - x1, wm->bh, x1, 0);
+        wm->barStats.pixelsCopied += static_cast<unsigned long>(x2 - x1) * wm->bh;
+    } else {
+        wm->barStats.idleFrames++;
+    }
+
+    wm->barStats.drawTime += monotonicMs() - start;
+    profileEnd(ProfileBar, mark);
+}
+
+// Draw all bars
+void drawBars() {
+    for (Monitor& m : g_windowManager->monitors) {
+        drawBar(&m);
+    }
+}
+
+// Repaint a bar window from its back buffer without redrawing anything
+void exposeBar(Monitor* m) {
+    WindowManager* wm = g_windowManager;
+
+    if (!m->showbar || !m->barbuf) return;
+    XCopyArea(wm->display, m->barbuf, m->barwin, wm->gc, 0, 0, m->ww, wm->bh, 0, 0);
+    wm->barStats.pixelsCopied += static_cast<unsigned long>(m->ww) * wm->bh;
+}
+
+// Forget what the back buffer holds so the next drawBar() renders every
+// segment, e.g. after the buffer was recreated
+void invalidateBar(Monitor* m) {
+    for (BarSegment& seg : m->barsegs) {
+        seg.x = seg.w = -1;
+        seg.key.clear();
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "nwm.h"
+
+// Status bar drawing
+void drawBar(Monitor* m);
+void drawBars();
+void exposeBar(Monitor* m);
+void invalidateBar(Monitor* m);
+int textWidth(const std::string& text);
@@ -0,0 +1,129 @@
+// Microbenchmark: Window -> Client lookup and churn.
+// Compares the old std::unordered_map<Window, std::unique_ptr<Client>>
+// against ObjectPool + WindowTable with 10k windows.
+
+#include "../nwm.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Same footprint as a real Client without pulling in window.cpp
+struct BenchClient {
+    explicit BenchClient(Window w) : window(w) {}
+    Window window;
+    char payload[sizeof(Client) - sizeof(Window)];
+};
+
+static constexpr int NUM_WINDOWS = 10000;
+static constexpr int LOOKUPS = 10000000;
+static constexpr int CHURN_ROUNDS = 100;
+static constexpr int CHURN_BATCH = 1000;
+
+static volatile unsigned long sink;
+
+static double now() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// XIDs as a server hands them out: a resource base per X client with
+// sequential ids below it
+static std::vector<Window> makeWindows(int n, unsigned int seed) {
+    std::vector<Window> wins;
+    std::mt19937 rng(seed);
+    for (int i = 0; wins.size() < (size_t)n; i++) {
+        Window base = (Window)(rng() % 255 + 1) << 21;
+        int perClient = rng() % 50 + 1;
+        for (int j = 0; j < perClient && wins.size() < (size_t)n; j++) {
+            wins.push_back(base | (Window)(i * 256 + j * 3 + 1));
+        }
+    }
+    return wins;
+}
+
+static void report(const char* impl, const char* op, double secs, long ops) {
+    printf("%-8s %-7s windows=%d ops=%ld ns_per_op=%.2f\n",
+           impl, op, NUM_WINDOWS, ops, secs * 1e9 / ops);
+}
+
+static void benchMap(const std::vector<Window>& wins, const std::vector<int>& order,
+                     const std::vector<Window>& fresh) {
+    std::unordered_map<Window, std::unique_ptr<BenchClient>> map;
+    for (Window w : wins) {
+        map[w] = std::make_unique<BenchClient>(w);
+    }
+
+    double t = now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        auto it = map.find(wins[order[i % order.size()]]);
+        sink += it->second->window;
+    }
+    report("map", "lookup", now() - t, LOOKUPS);
+
+    std::vector<Window> live(wins);
+    t = now();
+    for (int r = 0; r < CHURN_ROUNDS; r++) {
+        for (int i = 0; i < CHURN_BATCH; i++) {
+            size_t k = order[(r * CHURN_BATCH + i) % order.size()] % live.size();
+            map.erase(live[k]);
+            live[k] = fresh[r * CHURN_BATCH + i];
+            map[live[k]] = std::make_unique<BenchClient>(live[k]);
+        }
+    }
+    report("map", "churn", now() - t, (long)CHURN_ROUNDS * CHURN_BATCH);
+}
+
+static void benchTable(const std::vector<Window>& wins, const std::vector<int>& order,
+                       const std::vector<Window>& fresh) {
+    ObjectPool<BenchClient> pool;
+    WindowTable<BenchClient*> table;
+    for (Window w : wins) {
+        table.insert(w, pool.create(w));
+    }
+
+    double t = now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        sink += table.find(wins[order[i % order.size()]])->window;
+    }
+    report("table", "lookup", now() - t, LOOKUPS);
+
+    std::vector<Window> live(wins);
+    t = now();
+    for (int r = 0; r < CHURN_ROUNDS; r++) {
+        for (int i = 0; i < CHURN_BATCH; i++) {
+            size_t k = order[(r * CHURN_BATCH + i) % order.size()] % live.size();
+            pool.destroy(table.find(live[k]));
+            table.erase(live[k]);
+            live[k] = fresh[r * CHURN_BATCH + i];
+            table.insert(live[k], pool.create(live[k]));
+        }
+    }
+    report("table", "churn", now() - t, (long)CHURN_ROUNDS * CHURN_BATCH);
+
+    for (Window w : live) {
+        if (!table.find(w)) {
+            fprintf(stderr, "clientmap: lost window 0x%lx\n", w);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+int main() {
+    // One pool of distinct ids: the initial set, then the ones churned in
+    std::vector<Window> all = makeWindows(NUM_WINDOWS + CHURN_ROUNDS * CHURN_BATCH, 1);
+    std::vector<Window> wins(all.begin(), all.begin() + NUM_WINDOWS);
+    std::vector<Window> fresh(all.begin() + NUM_WINDOWS, all.end());
+
+    std::vector<int> order(1 << 16);
+    std::mt19937 rng(3);
+    for (int& i : order) {
+        i = rng() % NUM_WINDOWS;
+    }
+
+    benchMap(wins, order, fresh);
+    benchTable(wins, order, fresh);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+// Helpers shared by the benchmarks that drive a running nwm
+
+#include "../config.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static inline double now() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Same rules as nwm's runtimePath(), overridden by $NWM_SOCKET
+static inline std::string socketPath() {
+    const char* env = getenv("NWM_SOCKET");
+    if (env && *env) return env;
+
+    const char* dir = getenv("XDG_RUNTIME_DIR");
+    const char* dpy = getenv("DISPLAY");
+    std::string path = (dir && *dir) ? dir : "/tmp";
+
+    path += "/";
+    path += IPC_SOCKET;
+    if (dpy && *dpy) {
+        path += "-";
+        for (const char* p = dpy; *p; p++) {
+            path += (*p == '/') ? '_' : *p;
+        }
+    }
+    return path;
+}
+
+// Connect to nwm, retrying for up to timeoutMs while it starts. Returns
+// the socket or -1.
+static inline int connectNwm(const std::string& path, int timeoutMs) {
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    for (int waited = 0;; waited += 50) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+            return fd;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (waited >= timeoutMs) return -1;
+        usleep(50000);
+    }
+}
+
+// One connection and the reply bytes not yet consumed
+struct NwmConn {
+    int fd;
+    std::string pending;
+};
+
+// Send one message and collect its reply, query output included. Returns
+// false if nwm rejected it or went away; reply then holds what came back.
+static inline bool nwmCommand(NwmConn& conn, const std::string& msg, std::string& reply) {
+    char buf[4096];
+
+    reply.clear();
+    if (write(conn.fd, msg.data(), msg.size()) != static_cast<ssize_t>(msg.size())) return false;
+    for (;;) {
+        size_t nl;
+        while ((nl = conn.pending.find('\n')) != std::string::npos) {
+            std::string line = conn.pending.substr(0, nl + 1);
+            conn.pending.erase(0, nl + 1);
+            reply += line;
+            if (!line.compare(0, 3, "ok ")) return true;
+            if (!line.compare(0, 6, "error ")) return false;
+        }
+        ssize_t n = read(conn.fd, buf, sizeof(buf));
+        if (n <= 0) return false;
+        conn.pending.append(buf, n);
+    }
+}
+
+// Value of key=<number> in a stats line, or -1
+static inline long statsField(const std::string& stats, const char* key) {
+    size_t at = stats.find(std::string(" ") + key + "=");
+    if (at == std::string::npos) return -1;
+    return strtol(stats.c_str() + at + strlen(key) + 2, nullptr, 10);
+}
+
+// Latency distribution of a set of samples, in microseconds
+struct Latency {
+    double mean, p50, p99, max;
+};
+
+static inline Latency summarize(std::vector<double>& us) {
+    Latency l = {};
+    size_t n = us.size();
+    if (!n) return l;
+
+    std::sort(us.begin(), us.end());
+    for (double v : us) {
+        l.mean += v;
+    }
+    l.mean /= n;
+    l.p50 = us[n / 2];
+    l.p99 = us[std::min(n - 1, n * 99 / 100)];
+    l.max = us[n - 1];
+    return l;
+}
@@ -0,0 +1,51 @@
+// Benchmark: control socket throughput against a running nwm.
+// Sends messages of 1, 10 and 100 commands over one connection and
+// reports commands per second. Commands alternate "nmaster +" and
+// "nmaster -", so the window manager is left as it was found.
+//
+//   bench/ipc [socket]      (default: $NWM_SOCKET or nwm's usual path)
+
+#include "driver.h"
+
+static constexpr int BATCHES[] = { 1, 10, 100 };
+static constexpr int COMMANDS = 100000;  // Per batch size
+
+int main(int argc, char* argv[]) {
+    std::string path = argc > 1 ? argv[1] : socketPath();
+    NwmConn nwm = { connectNwm(path, 0), std::string() };
+    if (nwm.fd < 0) {
+        fprintf(stderr, "bench/ipc: cannot connect to %s: %s (is nwm running?)\n",
+                path.c_str(), strerror(errno));
+        return 1;
+    }
+
+    std::string reply;
+    for (int batch : BATCHES) {
+        // Even-sized batches undo themselves; single commands alternate
+        // across messages instead
+        std::string msg[2];
+        for (int i = 0; i < batch; i++) {
+            msg[0] += (i % 2) ? "nmaster -\n" : "nmaster +\n";
+            msg[1] += (i % 2) ? "nmaster +\n" : "nmaster -\n";
+        }
+        msg[0] += "\n";
+        msg[1] += "\n";
+
+        int messages = COMMANDS / batch;
+        double t = now();
+        for (int m = 0; m < messages; m++) {
+            if (!nwmCommand(nwm, msg[m % 2], reply)) {
+                fprintf(stderr, "bench/ipc: message failed: %s\n", reply.c_str());
+                return 1;
+            }
+        }
+        double secs = now() - t;
+
+        printf("ipc      batch=%-3d messages=%d commands=%d us_per_msg=%.2f cmds_per_sec=%.0f\n",
+               batch, messages, messages * batch, secs * 1e6 / messages,
+               messages * batch / secs);
+    }
+
+    close(nwm.fd);
+    return 0;
+}
@@ -0,0 +1,48 @@
+// Microbenchmark: pure layout geometry.
+// Runs tileGeometry and monocleGeometry over 1 to 10,000 clients into a
+// preallocated rect array and reports layouts per second. No X server.
+
+#include "../geometry.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static constexpr int CLIENTS[] = { 1, 10, 100, 1000, 10000 };
+static constexpr long RECTS = 20000000;  // Rects computed per measurement
+
+static volatile long sink;
+
+static double now() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void bench(const char* name, LayoutGeometry geometry, int n) {
+    std::vector<LayoutItem> items(n, LayoutItem{ 1 });
+    std::vector<Rect> rects(n);
+    LayoutArea area = { 0, 20, 1920, 1060, 0.55f, 1 };
+    long layouts = RECTS / n;
+
+    double t = now();
+    for (long i = 0; i < layouts; i++) {
+        // Vary the master count so the work cannot be hoisted out
+        area.nmaster = 1 + (i & 1);
+        geometry(area, items.data(), n, rects.data());
+        sink += rects[n - 1].h;
+    }
+    double secs = now() - t;
+
+    printf("layout   %-7s clients=%d layouts=%ld layouts_per_sec=%.0f ns_per_client=%.2f\n",
+           name, n, layouts, layouts / secs, secs * 1e9 / (layouts * n));
+}
+
+int main() {
+    for (int n : CLIENTS) {
+        bench("tile", tileGeometry, n);
+    }
+    for (int n : CLIENTS) {
+        bench("monocle", monocleGeometry, n);
+    }
+    return EXIT_SUCCESS;
+}
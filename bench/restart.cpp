@@ -0,0 +1,125 @@
+// Benchmark: in-place restart with N clients.
+// Maps N windows spread over the tags, then has nwm restart itself a few
+// times, timing each restart from the request until the new process
+// answers with every client managed. Also counts the map and unmap
+// notifications the clients saw, which should be none. bench/run.sh
+// starts Xvfb and nwm around it.
+//
+//   bench/restart [windows]
+
+#include "driver.h"
+#include <X11/Xlib.h>
+#include <poll.h>
+
+static constexpr int RESTARTS = 10;
+static constexpr int TIMEOUT_MS = 5000;
+
+static Display* dpy;
+static NwmConn nwm;
+
+static void die(const char* msg) {
+    fprintf(stderr, "bench/restart: %s\n", msg);
+    exit(1);
+}
+
+static std::string command(const std::string& msg) {
+    std::string reply;
+    if (!nwmCommand(nwm, msg + "\n\n", reply)) die(reply.empty() ? "nwm closed the control socket" : reply.c_str());
+    return reply;
+}
+
+static long wmStat(const char* key) {
+    long v = statsField(command("stats"), key);
+    if (v < 0) die("stats reply is missing a field");
+    return v;
+}
+
+// The old process drops the connection when it execs; poll for the new
+// one's socket finely, the default retry step is longer than a restart
+static void reconnect(double deadline) {
+    std::string path = socketPath();
+
+    close(nwm.fd);
+    nwm.pending.clear();
+    while ((nwm.fd = connectNwm(path, 0)) < 0) {
+        if (now() > deadline) die("nwm did not come back");
+        usleep(200);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int windows = argc > 1 ? atoi(argv[1]) : 100;
+    if (argc > 2 || windows <= 0) {
+        fprintf(stderr, "usage: bench/restart [windows]\n");
+        return 2;
+    }
+
+    for (int waited = 0; !(dpy = XOpenDisplay(nullptr)); waited += 50) {
+        if (waited >= TIMEOUT_MS) die("cannot open display");
+        usleep(50000);
+    }
+    if ((nwm.fd = connectNwm(socketPath(), TIMEOUT_MS)) < 0) {
+        die("cannot connect to nwm (is it running?)");
+    }
+
+    // Spread the windows over the tags, a few floating, and end on tag 1
+    Window root = DefaultRootWindow(dpy);
+    std::vector<Window> wins;
+    long base = wmStat("clients");
+    for (int i = 0; i < windows; i++) {
+        Window w = XCreateSimpleWindow(dpy, root, 0, 0, 64, 64, 0, 0, 0);
+        XSelectInput(dpy, w, StructureNotifyMask);
+        XMapWindow(dpy, w);
+        wins.push_back(w);
+    }
+    XSync(dpy, False);
+    double deadline = now() + TIMEOUT_MS / 1000.0;
+    while (wmStat("clients") != base + windows) {
+        if (now() > deadline) die("nwm did not manage every window");
+        usleep(1000);
+    }
+    for (int i = 0; i < windows; i++) {
+        std::string msg = "focus " + std::to_string(wins[i]) + "\ntag " + std::to_string(1 + i % 9);
+        command(msg);
+    }
+    command("view 1");
+    XSync(dpy, False);
+
+    // Drain what setting up caused, then count only the restarts
+    XEvent ev;
+    while (XPending(dpy)) XNextEvent(dpy, &ev);
+
+    std::vector<double> us;
+    long requests = 0;
+    for (int i = 0; i < RESTARTS; i++) {
+        double t = now();
+        command("restart");
+        reconnect(t + TIMEOUT_MS / 1000.0);
+        while (wmStat("clients") != base + windows) {
+            if (now() > t + TIMEOUT_MS / 1000.0) die("clients lost in restart");
+        }
+        us.push_back((now() - t) * 1e6);
+        requests += wmStat("requests");
+    }
+
+    unsigned long maps = 0, unmaps = 0;
+    XSync(dpy, False);
+    while (XPending(dpy)) {
+        XNextEvent(dpy, &ev);
+        maps += ev.type == MapNotify;
+        unmaps += ev.type == UnmapNotify;
+    }
+
+    Latency l = summarize(us);
+    printf("xvfb     op=restart windows=%d restarts=%d us_mean=%.1f us_p50=%.1f us_p99=%.1f "
+           "us_max=%.1f requests_per_restart=%.1f maps=%lu unmaps=%lu\n",
+           windows, RESTARTS, l.mean, l.p50, l.p99, l.max, (double)requests / RESTARTS,
+           maps, unmaps);
+
+    for (Window w : wins) {
+        XDestroyWindow(dpy, w);
+    }
+    XCloseDisplay(dpy);
+    close(nwm.fd);
+    return 0;
+}
@@ -0,0 +1,65 @@
+// Microbenchmark: rule matching at manage time.
+// Compiles tables of 10 to 10,000 class and instance rules, plus a few
+// title-only ones, and matches windows against them, half of which hit a
+// rule. Reports matches per second. No X server.
+
+#include "../rules.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static constexpr int RULE_COUNTS[] = { 10, 100, 1000, 10000 };
+static constexpr int TITLE_RULES = 4;    // Tried against every window
+static constexpr long MATCHES = 2000000;  // Per table size
+
+static volatile unsigned int sink;
+
+static double now() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void bench(int n) {
+    std::vector<std::string> names;
+    std::vector<Rule> rules;
+
+    // Every third rule keys on the instance, the rest on the class
+    for (int i = 0; i < n; i++) {
+        names.push_back("App" + std::to_string(i));
+    }
+    for (int i = 0; i < n; i++) {
+        const char* s = names[i].c_str();
+        rules.push_back(i % 3 ? Rule{ s, nullptr, nullptr, 1u << (i % 9), false, -1 }
+                              : Rule{ nullptr, s, nullptr, 0, true, -1 });
+    }
+    for (int i = 0; i < TITLE_RULES; i++) {
+        rules.push_back(Rule{ nullptr, nullptr, "Picture-in-Picture", 0, true, -1 });
+    }
+    compileRules(rules.data(), rules.size());
+
+    // Windows: half match a rule, half are unknown
+    std::vector<std::string> classes;
+    for (int i = 0; i < 256; i++) {
+        classes.push_back(i % 2 ? names[(i * 7919) % n] : "Other" + std::to_string(i));
+    }
+    std::string title = "make -j8 - build log - Terminal";
+
+    double t = now();
+    for (long i = 0; i < MATCHES; i++) {
+        const std::string& cls = classes[i & 255];
+        sink += matchRules(cls, cls, title).matched;
+    }
+    double secs = now() - t;
+
+    printf("rules    rules=%-5d matches=%ld matches_per_sec=%.0f ns_per_match=%.1f\n",
+           n + TITLE_RULES, MATCHES, MATCHES / secs, secs * 1e9 / MATCHES);
+}
+
+int main() {
+    for (int n : RULE_COUNTS) {
+        bench(n);
+    }
+    return EXIT_SUCCESS;
+}
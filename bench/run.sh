@@ -0,0 +1,44 @@
+#!/bin/sh
+# Run nwm under Xvfb and drive it with bench/xdrive at several window
+# counts, then bench/tagswitch and bench/restart. nwm is restarted for
+# each run so its peak RSS is per run. Prints one key=value line per
+# measurement.
+
+WINDOWS="10 100 1000"
+DPY=":${NWM_BENCH_DISPLAY:-99}"
+
+cd "$(dirname "$0")/.." || exit 1
+
+if ! command -v Xvfb >/dev/null 2>&1; then
+	echo "xvfb     skipped reason=Xvfb-not-found" >&2
+	exit 0
+fi
+
+rt=$(mktemp -d) || exit 1
+Xvfb "$DPY" -screen 0 1920x1080x24 -nolisten tcp >/dev/null 2>&1 &
+xvfb=$!
+nwm=
+trap 'kill $nwm $xvfb 2>/dev/null; wait 2>/dev/null; rm -rf "$rt"' EXIT INT TERM
+
+export DISPLAY="$DPY" XDG_RUNTIME_DIR="$rt"
+status=0
+
+# Run one driver against a fresh nwm
+drive() {
+	./nwm 2>"$rt/nwm.log" &
+	nwm=$!
+	if ! "$@"; then
+		cat "$rt/nwm.log" >&2
+		status=1
+	fi
+	kill $nwm 2>/dev/null
+	wait $nwm 2>/dev/null
+	nwm=
+}
+
+for n in $WINDOWS; do
+	drive ./bench/xdrive "$n"
+done
+drive ./bench/tagswitch 50
+drive ./bench/restart 100
+exit $status
@@ -0,0 +1,165 @@
+// Benchmark: tag switch latency with heavy clients, windows on hidden tags
+// unmapped versus parked offscreen. Fills tags 1 and 2 with windows that
+// redraw a few thousand rectangles on every Expose and rewrite WM_NAME
+// whenever they are mapped, like a busy browser or terminal would, then
+// flips between the two tags. A switch counts as done once every window
+// on the new tag has redrawn. bench/run.sh starts Xvfb and nwm around it.
+//
+//   bench/tagswitch [windows per tag]
+
+#include "driver.h"
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <poll.h>
+
+static constexpr int SWITCHES = 40;
+static constexpr int RECTS = 2000;  // Drawn per Expose
+static constexpr int TIMEOUT_MS = 5000;
+static constexpr const char* MODES[] = { "unmap", "offscreen" };
+
+// A synthetic client and whether it redrew since the last switch
+struct HeavyWindow {
+    Window win;
+    int tag;
+    bool drawn;
+};
+
+static Display* dpy;
+static GC gc;
+static NwmConn nwm;
+static std::vector<XRectangle> rects;
+static unsigned long mapNameCount;
+
+static void die(const char* msg) {
+    fprintf(stderr, "bench/tagswitch: %s\n", msg);
+    exit(1);
+}
+
+static std::string command(const std::string& msg) {
+    std::string reply;
+    if (!nwmCommand(nwm, msg + "\n\n", reply)) die(reply.empty() ? "nwm closed the control socket" : reply.c_str());
+    return reply;
+}
+
+static unsigned long requests() {
+    long v = statsField(command("stats"), "requests");
+    if (v < 0) die("stats reply is missing a field");
+    return v;
+}
+
+static HeavyWindow* find(std::vector<HeavyWindow>& wins, Window w) {
+    for (HeavyWindow& h : wins) {
+        if (h.win == w) return &h;
+    }
+    return nullptr;
+}
+
+// Play the clients' part until every window on tag has redrawn
+static void waitDrawn(std::vector<HeavyWindow>& wins, int tag) {
+    double deadline = now() + TIMEOUT_MS / 1000.0;
+    size_t left = 0;
+    XEvent ev;
+
+    for (HeavyWindow& h : wins) {
+        left += h.tag == tag && !h.drawn;
+    }
+    while (left) {
+        while (left && XPending(dpy)) {
+            XNextEvent(dpy, &ev);
+            HeavyWindow* h = find(wins, ev.xany.window);
+            if (!h) continue;
+
+            if (ev.type == Expose && ev.xexpose.count == 0) {
+                XFillRectangles(dpy, h->win, gc, rects.data(), rects.size());
+                if (!h->drawn && h->tag == tag) left--;
+                h->drawn = true;
+            } else if (ev.type == MapNotify) {
+                char name[32];
+                snprintf(name, sizeof(name), "heavy %lu", ++mapNameCount);
+                XStoreName(dpy, h->win, name);
+            }
+        }
+        XFlush(dpy);
+        int ms = (deadline - now()) * 1000;
+        if (ms <= 0) die("timed out waiting for windows to redraw");
+        if (left) {
+            struct pollfd pfd = { ConnectionNumber(dpy), POLLIN, 0 };
+            poll(&pfd, 1, ms);
+        }
+    }
+}
+
+static void run(const char* mode, int perTag) {
+    Window root = DefaultRootWindow(dpy);
+    std::vector<HeavyWindow> wins;
+    std::vector<double> us;
+
+    command(std::string("hide ") + mode);
+    for (int tag = 1; tag <= 2; tag++) {
+        command("view " + std::to_string(tag));
+        for (int i = 0; i < perTag; i++) {
+            Window w = XCreateSimpleWindow(dpy, root, 0, 0, 64, 64, 0, 0, 0);
+            XSelectInput(dpy, w, ExposureMask | StructureNotifyMask);
+            XMapWindow(dpy, w);
+            wins.push_back({ w, tag, false });
+        }
+        waitDrawn(wins, tag);
+    }
+
+    unsigned long before = requests();
+    for (int i = 0; i < SWITCHES; i++) {
+        int tag = 1 + i % 2;
+        for (HeavyWindow& h : wins) {
+            h.drawn = false;
+        }
+
+        double t = now();
+        command("view " + std::to_string(tag));
+        waitDrawn(wins, tag);
+        us.push_back((now() - t) * 1e6);
+    }
+    unsigned long after = requests();
+
+    Latency l = summarize(us);
+    printf("xvfb     op=tagswitch mode=%-9s windows_per_tag=%d switches=%d us_mean=%.1f "
+           "us_p50=%.1f us_p99=%.1f us_max=%.1f requests_per_switch=%.1f\n",
+           mode, perTag, SWITCHES, l.mean, l.p50, l.p99, l.max,
+           (double)(after - before) / SWITCHES);
+
+    for (HeavyWindow& h : wins) {
+        XDestroyWindow(dpy, h.win);
+    }
+    XSync(dpy, False);
+    command("view 1");
+}
+
+int main(int argc, char* argv[]) {
+    int perTag = argc > 1 ? atoi(argv[1]) : 50;
+    if (argc > 2 || perTag <= 0) {
+        fprintf(stderr, "usage: bench/tagswitch [windows per tag]\n");
+        return 2;
+    }
+
+    for (int waited = 0; !(dpy = XOpenDisplay(nullptr)); waited += 50) {
+        if (waited >= TIMEOUT_MS) die("cannot open display");
+        usleep(50000);
+    }
+    if ((nwm.fd = connectNwm(socketPath(), TIMEOUT_MS)) < 0) {
+        die("cannot connect to nwm (is it running?)");
+    }
+
+    gc = XCreateGC(dpy, DefaultRootWindow(dpy), 0, nullptr);
+    XSetForeground(dpy, gc, WhitePixel(dpy, DefaultScreen(dpy)));
+    for (int i = 0; i < RECTS; i++) {
+        rects.push_back({ (short)(i * 7 % 1900), (short)(i * 13 % 1060), 20, 20 });
+    }
+
+    for (const char* mode : MODES) {
+        run(mode, perTag);
+    }
+
+    XFreeGC(dpy, gc);
+    XCloseDisplay(dpy);
+    close(nwm.fd);
+    return 0;
+}
@@ -0,0 +1,187 @@
+// Benchmark driver: synthetic X clients against a running nwm.
+// Maps N windows one at a time, switches tags back and forth, then
+// destroys the windows, timing each operation from the client's side and
+// reading nwm's request counter and peak RSS over its control socket.
+// Unmanage times have the cost of the stats queries that detect it taken
+// out.
+// bench/run.sh starts Xvfb and nwm around it.
+//
+//   bench/xdrive <windows>
+
+#include "driver.h"
+#include <X11/Xlib.h>
+#include <poll.h>
+
+static constexpr int TAG_SWITCHES = 50;
+static constexpr int SETTLE_SAMPLES = 50;
+static constexpr int TIMEOUT_MS = 5000;
+
+// Counters from nwm's "stats" query
+struct WmStats {
+    unsigned long clients;
+    unsigned long requests;
+    long rssPeakKb;
+};
+
+static Display* dpy;
+static NwmConn nwm;
+static int windowCount;
+
+static void die(const char* msg) {
+    fprintf(stderr, "bench/xdrive: %s\n", msg);
+    exit(1);
+}
+
+// nwm may still be starting; retry for a while
+static void connectAll() {
+    for (int waited = 0; !dpy; waited += 50) {
+        if (!(dpy = XOpenDisplay(nullptr))) {
+            if (waited >= TIMEOUT_MS) die("cannot open display");
+            usleep(50000);
+        }
+    }
+    if ((nwm.fd = connectNwm(socketPath(), TIMEOUT_MS)) < 0) {
+        die("cannot connect to nwm (is it running?)");
+    }
+}
+
+static std::string command(const char* msg) {
+    std::string reply;
+    if (!nwmCommand(nwm, msg, reply)) die(reply.empty() ? "nwm closed the control socket" : reply.c_str());
+    return reply;
+}
+
+static unsigned long field(const std::string& s, const char* key) {
+    long v = statsField(s, key);
+    if (v < 0) die("stats reply is missing a field");
+    return v;
+}
+
+// Wait until nwm has finished what it was asked so far. The stats reply
+// comes after nwm flushed the previous batch; the XSync then lets the
+// server catch up on it.
+static WmStats settle() {
+    std::string s = command("stats\n\n");
+    WmStats st;
+
+    st.clients = field(s, "clients");
+    st.requests = field(s, "requests");
+    st.rssPeakKb = field(s, "rss_peak_kb");
+    XSync(dpy, False);
+    return st;
+}
+
+// What a settle() costs with nothing to wait for: the stats round trip
+// and the XSync. Unmanage is only seen through settle(), so this much per
+// call is driver overhead, not nwm work.
+static double settleCostUs() {
+    std::vector<double> us;
+
+    for (int i = 0; i < SETTLE_SAMPLES; i++) {
+        double t = now();
+        settle();
+        us.push_back((now() - t) * 1e6);
+    }
+    return summarize(us).p50;
+}
+
+// Read events until one for w matches, or give up
+template <typename Pred>
+static void waitFor(Window w, Pred match) {
+    double deadline = now() + TIMEOUT_MS / 1000.0;
+    XEvent ev;
+
+    for (;;) {
+        while (XPending(dpy)) {
+            XNextEvent(dpy, &ev);
+            if (ev.xany.window == w && match(ev)) return;
+        }
+        int left = (deadline - now()) * 1000;
+        if (left <= 0) die("timed out waiting for nwm");
+        struct pollfd pfd = { ConnectionNumber(dpy), POLLIN, 0 };
+        poll(&pfd, 1, left);
+    }
+}
+
+static void report(const char* op, std::vector<double>& us, unsigned long requests) {
+    Latency l = summarize(us);
+    printf("xvfb     op=%-8s windows=%d ops=%zu us_mean=%.1f us_p50=%.1f us_p99=%.1f us_max=%.1f "
+           "requests_per_op=%.2f\n",
+           op, windowCount, us.size(), l.mean, l.p50, l.p99, l.max, (double)requests / us.size());
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2 || (windowCount = atoi(argv[1])) <= 0) {
+        fprintf(stderr, "usage: bench/xdrive <windows>\n");
+        return 2;
+    }
+    connectAll();
+
+    Window root = DefaultRootWindow(dpy);
+    std::vector<Window> wins;
+    std::vector<double> us;
+    WmStats before = settle();
+
+    // Map: until the window is both mapped and given its tile
+    for (int i = 0; i < windowCount; i++) {
+        Window w = XCreateSimpleWindow(dpy, root, 0, 0, 1, 1, 0, 0, 0);
+        XSelectInput(dpy, w, StructureNotifyMask);
+        bool mapped = false, tiled = false;
+
+        double t = now();
+        XMapWindow(dpy, w);
+        XFlush(dpy);
+        waitFor(w, [&](const XEvent& ev) {
+            mapped |= ev.type == MapNotify;
+            tiled |= ev.type == ConfigureNotify &&
+                     (ev.xconfigure.width != 1 || ev.xconfigure.height != 1);
+            return mapped && tiled;
+        });
+        us.push_back((now() - t) * 1e6);
+        wins.push_back(w);
+    }
+    WmStats after = settle();
+    if (after.clients != before.clients + windowCount) die("nwm did not manage every window");
+    report("map", us, after.requests - before.requests);
+
+    // Tag switch: away from the windows and back
+    us.clear();
+    before = settle();
+    for (int i = 0; i < TAG_SWITCHES; i++) {
+        double t = now();
+        command(i % 2 ? "view 1\n\n" : "view 2\n\n");
+        settle();
+        us.push_back((now() - t) * 1e6);
+    }
+    after = settle();
+    report("view", us, after.requests - before.requests);
+
+    // Unmanage: until nwm has dropped the client, less the settle() calls
+    // it took to see that
+    us.clear();
+    double settleUs = settleCostUs();
+    before = after = settle();
+    long rssPeakKb = after.rssPeakKb;
+    while (!wins.empty()) {
+        unsigned long want = after.clients - 1;
+        int settles = 1;
+        double t = now();
+        XDestroyWindow(dpy, wins.back());
+        XFlush(dpy);
+        while ((after = settle()).clients != want) {
+            if ((now() - t) * 1000 > TIMEOUT_MS) die("timed out waiting for unmanage");
+            settles++;
+        }
+        us.push_back(std::max(0.0, (now() - t) * 1e6 - settles * settleUs));
+        wins.pop_back();
+    }
+    report("unmanage", us, after.requests - before.requests);
+    printf("xvfb     op=%-8s windows=%d us_p50=%.1f (subtracted per settle from unmanage)\n",
+           "settle", windowCount, settleUs);
+
+    printf("xvfb     op=%-8s windows=%d rss_peak_kb=%ld\n", "rss", windowCount, rssPeakKb);
+
+    XCloseDisplay(dpy);
+    close(nwm.fd);
+    return 0;
+}
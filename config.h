@@ -11,6 +11,12 @@ constexpr bool SHOW_BAR = true;     // Show status bar
 constexpr bool TOP_BAR = true;      // Status bar at top
 constexpr const char* FONT = "monospace:size=10";
 constexpr int BAR_HEIGHT = 20;      // Status bar height
+constexpr int EVENT_BATCH_MAX = 4096;  // Events handled before the other inputs get a turn
+constexpr double CONFIGURE_RATE = 60;   // Configure replies per second per client
+constexpr int CONFIGURE_BURST = 10;     // Replies allowed at once before CONFIGURE_RATE applies
+constexpr bool HIDE_BY_UNMAP = false;  // Unmap windows on hidden tags instead of parking them offscreen
+constexpr const char* STATUS_FIFO = "nwm-status";  // In $XDG_RUNTIME_DIR (or /tmp), suffixed with $DISPLAY
+constexpr const char* IPC_SOCKET = "nwm-ipc";      // Control socket, placed like STATUS_FIFO
 
 // Colors
 constexpr const char* COLOR_BORDER_NORMAL = "#444444";
@@ -29,6 +35,28 @@ constexpr float MASTER_FACTOR = 0.55;  // Factor of master area size [0.05..0.95
 constexpr int NUM_MASTER = 1;          // Number of clients in master area
 constexpr bool RESPECT_SIZE_HINTS = true; // Respect size hints in tiled resizals
 
+// Window rules, applied when a window is managed. Class and instance
+// (WM_CLASS) match exactly and title (WM_NAME) as a substring; nullptr
+// matches anything. Every matching rule applies in order: tags add up,
+// later rules override floating and monitor. tags 0 leaves the window on
+// the tags in view, monitor -1 on the current monitor. Rules naming a
+// class or instance are found by hash lookup; the others are tried
+// against every new window, so keep those few.
+struct Rule {
+    const char* cls;
+    const char* instance;
+    const char* title;
+    unsigned int tags;
+    bool isfloating;
+    int monitor;
+};
+
+constexpr Rule RULES[] = {
+    // class      instance  title    tags    floating  monitor
+    { "Gimp",     nullptr,  nullptr, 0,      true,     -1 },
+    { "Firefox",  nullptr,  nullptr, 1 << 8, false,    -1 },
+};
+
 // Applications
 constexpr const char* TERMINAL[] = { "x-terminal-emulator", nullptr };
 constexpr const char* MENU_PROGRAM[] = { "dmenu_run", nullptr };
@@ -38,8 +66,8 @@ constexpr const char* MENU_PROGRAM[] = { "dmenu_run", nullptr };
 #define TAGKEYS(KEY,TAG) \
     { MODKEY,                       KEY,      [](void* arg) { g_windowManager->viewTag(TAG); }, nullptr }, \
     { MODKEY|ControlMask,           KEY,      [](void* arg) { g_windowManager->toggleTag(TAG); }, nullptr }, \
-    { MODKEY|ShiftMask,             KEY,      [](void* arg) { g_windowManager->tagWindow(g_windowManager->getFocusedWindow(), TAG); }, nullptr }, \
-    { MODKEY|ControlMask|ShiftMask, KEY,      [](void* arg) { g_windowManager->toggleWindowTag(g_windowManager->getFocusedWindow(), TAG); }, nullptr }
+    { MODKEY|ShiftMask,             KEY,      [](void* arg) { g_windowManager->tagClient(g_windowManager->getFocusedClient(), TAG); }, nullptr }, \
+    { MODKEY|ControlMask|ShiftMask, KEY,      [](void* arg) { g_windowManager->toggleClientTag(g_windowManager->getFocusedClient(), TAG); }, nullptr }
 
 // Helper for spawning shell commands
 #define SHCMD(cmd) { .v = (const char*[]){ "/bin/sh", "-c", cmd, nullptr } }
@@ -52,4 +80,20 @@ struct KeyBinding {
     void* arg;
 };
 
-// Key bindings will be defined in nwm.cpp
\ No newline at end of file
+// Multi-key chord: the strokes are pressed one after the other. Strokes
+// past the last one are left zero. A chord may not start with a key that
+// is bound on its own.
+constexpr int CHORD_MAX = 3;
+
+struct KeyStroke {
+    unsigned int mod;
+    KeySym keysym;
+};
+
+struct KeyChord {
+    KeyStroke strokes[CHORD_MAX];
+    void (*func)(void*);
+    void* arg;
+};
+
+// Key bindings and chords are defined in nwm.cpp
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include "geometry.h"
+
+// Master column on the left, stack on the right, each split evenly
+void tileGeometry(const LayoutArea& area, const LayoutItem* items, size_t n, Rect* out) {
+    if (n == 0) return;
+
+    size_t nmaster = area.nmaster > 0 ? area.nmaster : 0;
+    size_t nm = n < nmaster ? n : nmaster;
+    int mw = area.w;
+
+    // Without master clients the stack takes the whole width
+    if (n > nmaster) {
+        mw = nmaster ? static_cast<int>(area.w * area.mfact) : 0;
+    }
+    int sx = area.x + mw, sw = area.w - mw;
+
+    // Each client takes an even share of what is left of its column, so
+    // rounding never leaves a gap at the bottom
+    int my = area.y, sy = area.y;
+    for (size_t i = 0; i < n; i++) {
+        int bw2 = 2 * items[i].bw;
+        Rect& r = out[i];
+
+        if (i < nm) {
+            int h = (area.h - (my - area.y)) / static_cast<int>(nm - i);
+            r = { area.x, my, mw - bw2, h - bw2 };
+            my += h;
+        } else {
+            int h = (area.h - (sy - area.y)) / static_cast<int>(n - i);
+            r = { sx, sy, sw - bw2, h - bw2 };
+            sy += h;
+        }
+    }
+}
+
+// Every client fills the whole area
+void monocleGeometry(const LayoutArea& area, const LayoutItem* items, size_t n, Rect* out) {
+    for (size_t i = 0; i < n; i++) {
+        int bw2 = 2 * items[i].bw;
+        out[i] = { area.x, area.y, area.w - bw2, area.h - bw2 };
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+// Pure layout geometry. Layouts read an array of per-client constraints
+// and fill a caller-allocated array of rectangles; nothing here touches X
+// or a Client, so layouts can run headless. layout.cpp gathers the
+// constraints and commits the result, sending only what changed.
+
+struct Rect {
+    int x, y, w, h;
+};
+
+// What a layout needs to know about one tiled client
+struct LayoutItem {
+    int bw;  // Border width; rects are the area inside the border
+
+    bool operator==(const LayoutItem& o) const { return bw == o.bw; }
+};
+
+// The window area and layout parameters of a monitor
+struct LayoutArea {
+    int x, y, w, h;
+    float mfact;
+    int nmaster;
+};
+
+// Fill out[0..n) with the geometry of n tiled clients
+typedef void (*LayoutGeometry)(const LayoutArea& area, const LayoutItem* items, size_t n, Rect* out);
+
+void tileGeometry(const LayoutArea& area, const LayoutItem* items, size_t n, Rect* out);
+void monocleGeometry(const LayoutArea& area, const LayoutItem* items, size_t n, Rect* out);
@@ -0,0 +1,392 @@
+#include "ipc.h"
+#include "nwm.h"
+#include "profile.h"
+#include "restart.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Control commands
+enum class IpcOp {
+    View, ToggleView, Tag, ToggleTag,
+    Layout, ToggleLayout,
+    Focus, FocusNext, FocusPrev, Kill,
+    NMasterInc, NMasterDec, MFactInc, MFactDec,
+    HideOffscreen, HideUnmap, Restart,
+    Stats, Configures, Profile
+};
+
+// A parsed command, applied only once the whole message has parsed
+struct IpcCommand {
+    IpcOp op;
+    int tag;
+    LayoutType layout;
+    Window win;
+};
+
+// Longest message buffered while waiting for the empty line ending it
+static constexpr size_t MESSAGE_MAX = 8192;
+
+// One client connection and the bytes not yet consumed
+struct IpcConn {
+    int fd;
+    std::string in;
+};
+
+static int listenFd = -1;
+static std::string socketPath;
+static std::vector<IpcConn> conns;
+static std::vector<IpcCommand> parsed;  // Reused across messages
+static IpcStats stats;
+
+bool openIpc() {
+    struct sockaddr_un addr;
+
+    socketPath = runtimePath(IPC_SOCKET);
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "nwm: ipc socket path too long: %s\n", socketPath.c_str());
+        return false;
+    }
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        fprintf(stderr, "nwm: cannot create ipc socket: %s\n", strerror(errno));
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    // The path may be in a shared /tmp: only replace a stale socket of
+    // our own, never whatever someone else put there
+    struct stat st;
+    if (lstat(socketPath.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode) || st.st_uid != getuid()) {
+            fprintf(stderr, "nwm: %s exists and is not our socket\n", socketPath.c_str());
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        unlink(socketPath.c_str());
+    }
+
+    // Only our user may connect
+    mode_t mask = umask(077);
+    int bound = bind(listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    umask(mask);
+
+    if (bound < 0 || listen(listenFd, 16) < 0) {
+        fprintf(stderr, "nwm: cannot listen on %s: %s\n", socketPath.c_str(), strerror(errno));
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    return true;
+}
+
+void closeIpc() {
+    for (IpcConn& conn : conns) {
+        close(conn.fd);
+    }
+    conns.clear();
+
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(socketPath.c_str());
+        listenFd = -1;
+    }
+}
+
+size_t ipcPollFds(std::vector<struct pollfd>& fds) {
+    size_t n = 0;
+
+    if (listenFd >= 0) {
+        fds.push_back({ listenFd, POLLIN, 0 });
+        n++;
+    }
+    for (const IpcConn& conn : conns) {
+        fds.push_back({ conn.fd, POLLIN, 0 });
+        n++;
+    }
+    return n;
+}
+
+// Tags are numbered from 1 on the wire, like their labels
+static bool parseTag(const char* arg, int& tag) {
+    char* end;
+    long t = arg ? strtol(arg, &end, 10) : 0;
+
+    if (!arg || *end || t < 1 || t > NUM_TAGS) return false;
+    tag = t - 1;
+    return true;
+}
+
+static bool parseWindow(const char* arg, Window& win) {
+    char* end;
+
+    if (!arg) return false;
+    win = strtoul(arg, &end, 0);
+    return !*end && g_windowManager->getClientByWindow(win);
+}
+
+// Parse one command line; returns nullptr on success or the reason it failed
+static const char* parseCommand(char* line, IpcCommand& cmd) {
+    char* save;
+    char* verb = strtok_r(line, " \t", &save);
+    char* arg = strtok_r(nullptr, " \t", &save);
+
+    if (strtok_r(nullptr, " \t", &save)) return "too many arguments";
+
+    cmd.win = None;
+    if (!strcmp(verb, "view") || !strcmp(verb, "toggleview") ||
+        !strcmp(verb, "tag") || !strcmp(verb, "toggletag")) {
+        if (!parseTag(arg, cmd.tag)) return "bad tag";
+        cmd.op = !strcmp(verb, "view") ? IpcOp::View
+               : !strcmp(verb, "toggleview") ? IpcOp::ToggleView
+               : !strcmp(verb, "tag") ? IpcOp::Tag : IpcOp::ToggleTag;
+    } else if (!strcmp(verb, "layout")) {
+        cmd.op = IpcOp::Layout;
+        if (!arg) return "missing layout";
+        if (!strcmp(arg, "tile")) cmd.layout = LayoutType::TILED;
+        else if (!strcmp(arg, "float")) cmd.layout = LayoutType::FLOATING;
+        else if (!strcmp(arg, "monocle")) cmd.layout = LayoutType::MONOCLE;
+        else if (!strcmp(arg, "toggle")) cmd.op = IpcOp::ToggleLayout;
+        else return "unknown layout";
+    } else if (!strcmp(verb, "focus")) {
+        cmd.op = IpcOp::Focus;
+        if (arg && !strcmp(arg, "next")) cmd.op = IpcOp::FocusNext;
+        else if (arg && !strcmp(arg, "prev")) cmd.op = IpcOp::FocusPrev;
+        else if (!parseWindow(arg, cmd.win)) return "no such client";
+    } else if (!strcmp(verb, "kill")) {
+        cmd.op = IpcOp::Kill;
+        if (arg && !parseWindow(arg, cmd.win)) return "no such client";
+    } else if (!strcmp(verb, "nmaster") || !strcmp(verb, "mfact")) {
+        bool nmaster = !strcmp(verb, "nmaster");
+        if (!arg || (strcmp(arg, "+") && strcmp(arg, "-"))) return "expected + or -";
+        cmd.op = nmaster ? (*arg == '+' ? IpcOp::NMasterInc : IpcOp::NMasterDec)
+                         : (*arg == '+' ? IpcOp::MFactInc : IpcOp::MFactDec);
+    } else if (!strcmp(verb, "hide")) {
+        if (!arg) return "missing mode";
+        if (!strcmp(arg, "offscreen")) cmd.op = IpcOp::HideOffscreen;
+        else if (!strcmp(arg, "unmap")) cmd.op = IpcOp::HideUnmap;
+        else return "unknown mode";
+    } else if (!strcmp(verb, "restart")) {
+        cmd.op = IpcOp::Restart;
+        if (arg) return "too many arguments";
+    } else if (!strcmp(verb, "stats") || !strcmp(verb, "configures") || !strcmp(verb, "profile")) {
+        cmd.op = !strcmp(verb, "stats") ? IpcOp::Stats
+               : !strcmp(verb, "configures") ? IpcOp::Configures : IpcOp::Profile;
+        if (arg) return "too many arguments";
+    } else {
+        return "unknown command";
+    }
+    return nullptr;
+}
+
+// Counters for benchmarks and monitoring. requests is the number of X
+// requests nwm has issued, so the difference between two queries is the
+// cost of whatever happened in between.
+static void appendStats(std::string& out) {
+    WindowManager* wm = g_windowManager;
+    struct rusage ru;
+    char line[1024];
+
+    getrusage(RUSAGE_SELF, &ru);
+    snprintf(line, sizeof(line),
+             "stats clients=%zu requests=%lu round_trips=%lu grabs=%lu events=%lu configures=%lu "
+             "configures_avoided=%lu configure_requests=%lu configure_replies=%lu "
+             "configure_deferred=%lu layouts_computed=%lu layouts_replayed=%lu restacks=%lu "
+             "restack_requests=%lu restack_requests_saved=%lu bar_frames=%lu title_changes=%lu "
+             "title_reads=%lu ipc_messages=%lu ipc_commands=%lu rss_peak_kb=%ld\n",
+             wm->clients.size(), NextRequest(wm->display) - 1, serverCounters.roundTrips,
+             serverCounters.grabs, wm->eventStats.dispatched,
+             wm->configureStats.sent, wm->configureStats.avoided, wm->configureStats.requests,
+             wm->configureStats.replies, wm->configureStats.deferred, wm->layoutStats.computed,
+             wm->layoutStats.replayed, wm->restackStats.restacks, wm->restackStats.requests,
+             wm->restackStats.saved, wm->barStats.frames, titleStats().changes, titleStats().reads,
+             stats.messages, stats.commands, ru.ru_maxrss);
+    out += line;
+}
+
+// ConfigureRequest counts of every client that sent any, busiest first,
+// to find the ones flooding the window manager
+static void appendConfigures(std::string& out) {
+    std::vector<Client*> busy;
+    char line[160];
+
+    for (Monitor& m : g_windowManager->monitors) {
+        for (Client* c = m.clients; c; c = c->next) {
+            if (c->flood.requests) {
+                busy.push_back(c);
+            }
+        }
+    }
+    std::sort(busy.begin(), busy.end(), [](Client* a, Client* b) {
+        return a->flood.requests > b->flood.requests;
+    });
+    for (Client* c : busy) {
+        snprintf(line, sizeof(line), "configure window=0x%lx requests=%lu replies=%lu deferred=%lu\n",
+                 c->window, c->flood.requests, c->flood.replies, c->flood.deferred);
+        out += line;
+    }
+}
+
+static void applyCommand(const IpcCommand& cmd, std::string& out) {
+    WindowManager* wm = g_windowManager;
+    Client* c = cmd.win ? wm->getClientByWindow(cmd.win) : wm->getFocusedClient();
+
+    switch (cmd.op) {
+        case IpcOp::View:         wm->viewTag(cmd.tag); break;
+        case IpcOp::ToggleView:   wm->toggleTag(cmd.tag); break;
+        case IpcOp::Tag:          wm->tagClient(c, cmd.tag); break;
+        case IpcOp::ToggleTag:    wm->toggleClientTag(c, cmd.tag); break;
+        case IpcOp::Layout:       wm->setLayout(cmd.layout); break;
+        case IpcOp::ToggleLayout: wm->toggleLayout(); break;
+        case IpcOp::Focus:
+            // Bring a hidden client into view first, as its first tag
+            if (c && !ISVISIBLE(c)) {
+                wm->currentMonitor = c->mon->num;
+                wm->viewTag(__builtin_ctz(c->tags));
+            }
+            wm->focusClient(c);
+            break;
+        case IpcOp::FocusNext:    wm->focusStack(+1); break;
+        case IpcOp::FocusPrev:    wm->focusStack(-1); break;
+        case IpcOp::Kill:         wm->killClient(c); break;
+        case IpcOp::NMasterInc:   wm->increaseMasterCount(); break;
+        case IpcOp::NMasterDec:   wm->decreaseMasterCount(); break;
+        case IpcOp::MFactInc:     wm->increaseMasterSize(); break;
+        case IpcOp::MFactDec:     wm->decreaseMasterSize(); break;
+        case IpcOp::HideOffscreen:
+        case IpcOp::HideUnmap:
+            wm->hideByUnmap = cmd.op == IpcOp::HideUnmap;
+            wm->arrange();
+            break;
+        case IpcOp::Restart:      restart(nullptr); break;
+        case IpcOp::Stats:        appendStats(out); break;
+        case IpcOp::Configures:   appendConfigures(out); break;
+        case IpcOp::Profile:      profileDump(out); break;
+    }
+}
+
+// Parse every command of a message, then apply them all. The resulting
+// arranges are only marked here and run once at the end of the batch.
+static void runMessage(IpcConn& conn, std::string& msg) {
+    std::string out;
+    char reply[128];
+    char* save;
+    unsigned int n = 0;
+
+    ProfileMark mark = profileBegin();
+    stats.messages++;
+    parsed.clear();
+    for (char* line = strtok_r(&msg[0], "\n;", &save); line; line = strtok_r(nullptr, "\n;", &save)) {
+        while (*line == ' ' || *line == '\t') line++;
+        if (!*line) continue;
+
+        IpcCommand cmd;
+        const char* err = parseCommand(line, cmd);
+        n++;
+        if (err) {
+            snprintf(reply, sizeof(reply), "error %u: %s\n", n, err);
+            send(conn.fd, reply, strlen(reply), MSG_NOSIGNAL);
+            stats.errors++;
+            profileEnd(ProfileIpc, mark);
+            return;
+        }
+        parsed.push_back(cmd);
+    }
+
+    for (const IpcCommand& cmd : parsed) {
+        applyCommand(cmd, out);
+    }
+    stats.commands += parsed.size();
+
+    snprintf(reply, sizeof(reply), "ok %zu\n", parsed.size());
+    out += reply;
+    send(conn.fd, out.data(), out.size(), MSG_NOSIGNAL);
+    profileEnd(ProfileIpc, mark);
+}
+
+// Read what a connection sent and run each complete message. Returns
+// false once the connection is finished.
+static bool serviceConn(IpcConn& conn, short revents) {
+    char buf[4096];
+    ssize_t n = -1;
+    bool eof = (revents & (POLLHUP | POLLERR)) && !(revents & POLLIN);
+
+    while (!eof && (n = recv(conn.fd, buf, sizeof(buf), MSG_DONTWAIT)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            eof = (errno != EAGAIN && errno != EWOULDBLOCK);
+            break;
+        }
+        conn.in.append(buf, n);
+        if (conn.in.size() > MESSAGE_MAX) break;  // Take the rest next time
+    }
+    if (n == 0) {
+        eof = true;
+    }
+
+    // Messages end with an empty line
+    size_t end;
+    while ((end = conn.in.find("\n\n")) != std::string::npos) {
+        std::string msg = conn.in.substr(0, end);
+        conn.in.erase(0, end + 2);
+        runMessage(conn, msg);
+    }
+
+    // A message that never ends would be buffered forever
+    if (conn.in.size() > MESSAGE_MAX) {
+        static const char reply[] = "error message too long\n";
+        send(conn.fd, reply, sizeof(reply) - 1, MSG_NOSIGNAL);
+        return false;
+    }
+
+    // Whatever is left when the client stops writing is the last message
+    if (eof && conn.in.find_first_not_of(" \t\n;") != std::string::npos) {
+        runMessage(conn, conn.in);
+        conn.in.clear();
+    }
+    return !eof;
+}
+
+void handleIpc(const struct pollfd* first, size_t n) {
+    size_t base = (listenFd >= 0) ? 1 : 0;
+
+    // Connections first, back to front so closing one keeps indices valid
+    for (size_t i = n; i-- > base;) {
+        size_t c = i - base;
+        if (c >= conns.size() || !first[i].revents) continue;
+        if (!serviceConn(conns[c], first[i].revents)) {
+            close(conns[c].fd);
+            conns.erase(conns.begin() + c);
+        }
+    }
+
+    if (base && (first[0].revents & POLLIN)) {
+        int fd;
+        while ((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+            // The socket mode already keeps others out; check anyway
+            struct ucred cred;
+            socklen_t len = sizeof(cred);
+            if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 || cred.uid != getuid()) {
+                close(fd);
+                continue;
+            }
+            conns.push_back({ fd, std::string() });
+        }
+    }
+}
+
+const IpcStats& ipcStats() {
+    return stats;
+}
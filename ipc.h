@@ -0,0 +1,47 @@
+#pragma once
+
+#include "nwm.h"
+#include <poll.h>
+
+// Unix socket control interface.
+//
+// A message is one or more commands, one per line (or separated by ';'),
+// ended by an empty line or by the client closing its write side. Every
+// command in a message is parsed before any is applied, so a message is
+// all-or-nothing, and the layout changes it causes are flushed with the
+// rest of the event batch in a single arrange. Each message gets one
+// reply line: "ok <commands>" or "error <command>: <reason>", preceded
+// by the output of any queries in it.
+//
+// Commands:
+//   view <tag>         toggleview <tag>      tag <tag>      toggletag <tag>
+//   layout tile|float|monocle|toggle         focus <window>|next|prev
+//   kill [<window>]    nmaster +|-           mfact +|-
+//   hide offscreen|unmap                     how windows on hidden tags are hidden
+//   restart            exec nwm again, keeping every client's state
+// focus <window> views the window's first tag if none of its tags is shown.
+//
+// Queries:
+//   stats              one line of key=value counters
+//   configures         ConfigureRequest counts per client, busiest first
+//   profile            per-handler latency histograms, see profile.h
+//
+// A message is answered before the arrange it caused is flushed, so a
+// query sent after that reply sees the finished result.
+bool openIpc();
+void closeIpc();
+
+// Append the listening socket and client connections to fds; the return
+// value is the number appended
+size_t ipcPollFds(std::vector<struct pollfd>& fds);
+
+// Service the descriptors ipcPollFds() appended, starting at first
+void handleIpc(const struct pollfd* first, size_t n);
+
+// Throughput counters
+struct IpcStats {
+    unsigned long messages;
+    unsigned long commands;
+    unsigned long errors;
+};
+const IpcStats& ipcStats();
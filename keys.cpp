@@ -0,0 +1,209 @@
+#include "keys.h"
+#include "profile.h"
+#include <X11/keysym.h>
+#include <bitset>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+// What a stroke does: run func, or with func null, open node next for the
+// following stroke
+struct KeyAction {
+    void (*func)(void*);
+    void* arg;
+    uint32_t next;
+};
+
+// Keyed by node << 16 | mask << 8 | keycode; node 0 holds first strokes
+static std::unordered_map<uint32_t, KeyAction> table;
+// Keycodes by keysym, only while binding: those producing it unshifted,
+// and those producing it at some other level only
+static std::unordered_multimap<KeySym, KeyCode> codesBySym;
+static std::unordered_multimap<KeySym, KeyCode> levelCodesBySym;
+static std::vector<KeyCode> strokeCodes;  // Scratch for addStroke()
+static std::bitset<256> modifierKeys;  // Keycodes of Shift, Control and the like
+static unsigned int numlock;
+static uint32_t nodes;        // Chord nodes allocated
+static uint32_t chordNode;    // Node the next press is looked up in
+
+static unsigned int cleanMask(unsigned int mask) {
+    return mask & ~(numlock | LockMask) &
+           (ShiftMask | ControlMask | Mod1Mask | Mod2Mask | Mod3Mask | Mod4Mask | Mod5Mask);
+}
+
+static uint32_t tableKey(uint32_t node, unsigned int mask, KeyCode code) {
+    return node << 16 | cleanMask(mask) << 8 | code;
+}
+
+// Which keycodes are modifiers, and which modifier NumLock is
+void updateNumlockMask() {
+    WindowManager* wm = g_windowManager;
+    KeyCode numlockCode = XKeysymToKeycode(wm->display, XK_Num_Lock);
+
+    numlock = 0;
+    modifierKeys.reset();
+    countRoundTrips();
+    XModifierKeymap* modmap = XGetModifierMapping(wm->display);
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < modmap->max_keypermod; j++) {
+            KeyCode code = modmap->modifiermap[i * modmap->max_keypermod + j];
+            if (!code) continue;
+            modifierKeys.set(code);
+            if (code == numlockCode) {
+                numlock = 1u << i;
+            }
+        }
+    }
+    XFreeModifiermap(modmap);
+}
+
+unsigned int numlockMask() {
+    return numlock;
+}
+
+// Keycodes producing each keysym at any level, from one GetKeyboardMapping
+static void mapKeysyms() {
+    Display* dpy = g_windowManager->display;
+    int min, max, per;
+
+    codesBySym.clear();
+    levelCodesBySym.clear();
+    XDisplayKeycodes(dpy, &min, &max);
+    countRoundTrips();
+    KeySym* syms = XGetKeyboardMapping(dpy, min, max - min + 1, &per);
+    if (!syms) return;
+    for (int k = min; k <= max; k++) {
+        const KeySym* row = syms + (k - min) * per;
+        if (row[0] != NoSymbol) {
+            codesBySym.emplace(row[0], k);
+        }
+        for (int level = 1; level < per; level++) {
+            // Levels often repeat one another; one entry per keycode
+            bool seen = row[level] == NoSymbol || row[level] == row[0];
+            for (int l = 1; l < level && !seen; l++) {
+                seen = row[l] == row[level];
+            }
+            if (!seen) {
+                levelCodesBySym.emplace(row[level], k);
+            }
+        }
+    }
+    XFree(syms);
+}
+
+// Keycodes to bind sym to: where it is unshifted, or failing that, where
+// it is at another level, as XKeysymToKeycode would find it
+static void keycodesFor(KeySym sym, std::vector<KeyCode>& codes) {
+    auto range = codesBySym.equal_range(sym);
+    if (range.first == range.second) {
+        range = levelCodesBySym.equal_range(sym);
+    }
+    codes.clear();
+    for (auto it = range.first; it != range.second; ++it) {
+        codes.push_back(it->second);
+    }
+}
+
+enum StrokeResult { StrokeBound, StrokeClash, StrokeNoKey };
+
+// Bind a stroke at node to func, or with func null to a chord node, which
+// is shared with earlier chords opening the same way. next gets that node.
+static StrokeResult addStroke(uint32_t node, unsigned int mod, KeySym sym, void (*func)(void*),
+                              void* arg, uint32_t& next) {
+    WindowManager* wm = g_windowManager;
+
+    next = 0;
+    keycodesFor(sym, strokeCodes);
+    if (strokeCodes.empty()) return StrokeNoKey;
+    for (KeyCode code : strokeCodes) {
+        auto found = table.find(tableKey(node, mod, code));
+        if (found == table.end()) continue;
+        if (func || found->second.func) return StrokeClash;
+        next = found->second.next;
+    }
+    if (!func && !next) {
+        next = ++nodes;
+    }
+
+    unsigned int locks[] = { 0, LockMask, numlock, numlock | LockMask };
+    for (KeyCode code : strokeCodes) {
+        table[tableKey(node, mod, code)] = { func, arg, next };
+        if (node != 0) continue;
+        for (unsigned int lock : locks) {
+            XGrabKey(wm->display, code, cleanMask(mod) | lock, wm->root, True,
+                     GrabModeAsync, GrabModeAsync);
+        }
+    }
+    return StrokeBound;
+}
+
+// Say why a binding could not be added
+static void warnStroke(StrokeResult r, const char* what, size_t i, KeySym sym) {
+    if (r == StrokeClash) {
+        fprintf(stderr, "nwm: %s %zu clashes with an earlier binding\n", what, i);
+    } else if (r == StrokeNoKey) {
+        const char* name = XKeysymToString(sym);
+        fprintf(stderr, "nwm: %s %zu: no key produces %s\n", what, i, name ? name : "its keysym");
+    }
+}
+
+void bindKeys(const KeyBinding* keys, size_t nkeys, const KeyChord* chords, size_t nchords) {
+    WindowManager* wm = g_windowManager;
+    uint32_t next;
+
+    updateNumlockMask();
+    mapKeysyms();
+    table.clear();
+    nodes = 0;
+    chordNode = 0;
+    XUngrabKey(wm->display, AnyKey, AnyModifier, wm->root);
+
+    for (size_t i = 0; i < nkeys; i++) {
+        StrokeResult r = addStroke(0, keys[i].mod, keys[i].keysym, keys[i].func, keys[i].arg, next);
+        warnStroke(r, "key binding", i, keys[i].keysym);
+    }
+
+    for (size_t i = 0; i < nchords; i++) {
+        const KeyChord& ch = chords[i];
+        uint32_t node = 0;
+        for (int s = 0; s < CHORD_MAX && ch.strokes[s].keysym != NoSymbol; s++) {
+            bool last = s + 1 == CHORD_MAX || ch.strokes[s + 1].keysym == NoSymbol;
+            StrokeResult r = addStroke(node, ch.strokes[s].mod, ch.strokes[s].keysym,
+                                       last ? ch.func : nullptr, ch.arg, next);
+            if (r != StrokeBound) {
+                warnStroke(r, "key chord", i, ch.strokes[s].keysym);
+                break;
+            }
+            node = next;
+        }
+    }
+    codesBySym.clear();
+    levelCodesBySym.clear();
+}
+
+bool dispatchKey(const XKeyEvent* e) {
+    WindowManager* wm = g_windowManager;
+
+    // Modifiers pressed between the strokes of a chord
+    if (modifierKeys.test(e->keycode)) return true;
+
+    bool inChord = chordNode != 0;
+    auto it = table.find(tableKey(chordNode, e->state, e->keycode));
+    chordNode = 0;
+
+    if (it != table.end() && !it->second.func) {
+        if (!inChord) {
+            countRoundTrips();
+            XGrabKeyboard(wm->display, wm->root, False, GrabModeAsync, GrabModeAsync, CurrentTime);
+        }
+        chordNode = it->second.next;
+        return true;
+    }
+
+    if (inChord) {
+        XUngrabKeyboard(wm->display, CurrentTime);
+    }
+    if (it == table.end()) return false;
+    it->second.func(it->second.arg);
+    return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "nwm.h"
+
+// Key binding dispatch.
+//
+// bindKeys() compiles the bindings and chords into one hash table keyed by
+// chord position, cleaned modifier mask and keycode, resolving keysyms to
+// keycodes once from the keyboard mapping, and grabs every first stroke on
+// the root window. A key press is then a single lookup, whatever the
+// number of bindings. A stroke that opens a chord grabs the keyboard until
+// the chord completes or a key outside it is pressed.
+
+// Rebuild the table and the grabs, e.g. after a MappingNotify
+void bindKeys(const KeyBinding* keys, size_t nkeys, const KeyChord* chords, size_t nchords);
+
+// Run the binding of a key press or advance a chord. Returns false if the
+// key is not bound at this point.
+bool dispatchKey(const XKeyEvent* e);
+
+// NumLock's modifier bit, ignored like CapsLock when matching bindings
+unsigned int numlockMask();
@@ -1,83 +1,67 @@
 #include "layout.h"
 #include "window.h"
+#include "bar.h"
 #include "nwm.h"
+#include "geometry.h"
 #include <X11/Xlib.h>
 
-// Tile layout
-void tileLayout(Monitor* m) {
-    if (!m) return;
-    
-    unsigned int i, n;
-    int mx, my, mw, mh;
-    int sx, sy, sw, sh;
-    float mfact;
-    int nmaster;
-    Client* c;
-    
-    // Count number of visible clients
-    n = 0;
-    for (i = 0; i < m->tags[m->selectedTag].clients.size(); i++) {
-        c = m->tags[m->selectedTag].clients[i];
-        if (!c->isfloating && !c->isfullscreen) {
-            n++;
-        }
+// Scratch space for the layout pass, grown as needed and reused
+static std::vector<Client*> tiled;
+static std::vector<LayoutItem> items;
+
+static bool sameArea(const LayoutArea& a, const LayoutArea& b) {
+    return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h &&
+           a.mfact == b.mfact && a.nmaster == b.nmaster;
+}
+
+// Run a geometry function over the tiled clients of a monitor and commit
+// the result. The output only depends on the area, the layout and the
+// clients' constraints, so when those match what the selected tag last
+// computed, its cached rects are replayed instead. resize() then drops
+// every request that matches what the server already has, so windows
+// that did not move cost nothing.
+static void commitLayout(Monitor* m, LayoutGeometry geometry) {
+    Tag& tag = m->tag();
+    TagGeometry& cache = tag.geometry;
+
+    tiled.clear();
+    items.clear();
+    for (Client* c = nexttiled(m->clients); c; c = nexttiled(c->next)) {
+        tiled.push_back(c);
+        items.push_back({ c->bw });
     }
-    
-    if (n == 0) return;
-    
-    // Calculate master and stack areas
-    mx = m->x;
-    my = m->y;
-    mw = m->width;
-    mh = m->height;
-    
-    mfact = m->mfact;
-    nmaster = m->nmaster;
-    
-    if (n > nmaster) {
-        sw = mw * (1 - mfact);
-        sx = mx + mw - sw;
-        sh = mh;
-        sy = my;
-        
-        mw = mw * mfact;
+    if (tiled.empty()) return;
+
+    LayoutArea area = { m->wx, m->wy, m->ww, m->wh, tag.mfact, tag.nmaster };
+    if (cache.valid && cache.layout == tag.layout && sameArea(cache.area, area) &&
+        cache.items == items) {
+        g_windowManager->layoutStats.replayed++;
+    } else {
+        cache.rects.resize(tiled.size());
+        geometry(area, items.data(), items.size(), cache.rects.data());
+        cache.valid = true;
+        cache.layout = tag.layout;
+        cache.area = area;
+        cache.items = items;
+        g_windowManager->layoutStats.computed++;
     }
-    
-    // Arrange clients
-    int tx = mx, ty = my;
-    int tw = mw, th = mh;
-    
-    for (i = 0, c = nullptr; i < m->tags[m->selectedTag].clients.size(); i++) {
-        c = m->tags[m->selectedTag].clients[i];
-        if (!c->isfloating && !c->isfullscreen) {
-            if (i < (unsigned int)nmaster) {
-                // Master area
-                th = (mh - ty + my) / (MIN(n, nmaster) - i);
-                resize(c, tx, ty, tw - 2 * c->bw, th - 2 * c->bw, false);
-                ty += HEIGHT(c);
-            } else {
-                // Stack area
-                sh = (mh - sy + my) / (n - i);
-                resize(c, sx, sy, sw - 2 * c->bw, sh - 2 * c->bw, false);
-                sy += HEIGHT(c);
-            }
-        }
+
+    for (size_t i = 0; i < tiled.size(); i++) {
+        const Rect& r = cache.rects[i];
+        resize(tiled[i], r.x, r.y, r.w, r.h, false);
     }
 }
 
+// Tile layout
+void tileLayout(Monitor* m) {
+    if (!m) return;
+    commitLayout(m, tileGeometry);
+}
+
 // Monocle layout
 void monocleLayout(Monitor* m) {
     if (!m) return;
-    
-    unsigned int i;
-    Client* c;
-    
-    for (i = 0; i < m->tags[m->selectedTag].clients.size(); i++) {
-        c = m->tags[m->selectedTag].clients[i];
-        if (!c->isfloating && !c->isfullscreen) {
-            resize(c, m->x, m->y, m->width - 2 * c->bw, m->height - 2 * c->bw, false);
-        }
-    }
+    commitLayout(m, monocleGeometry);
 }
 
 // Set layout
@@ -87,10 +71,10 @@ void setLayout(const LayoutType layout) {
     Monitor* m = g_windowManager->getCurrentMonitor();
     if (!m) return;
     
-    m->previousLayout = m->currentLayout;
-    m->currentLayout = layout;
+    m->tag().previousLayout = m->tag().layout;
+    m->tag().layout = layout;
     
-    arrange(m);
+    g_windowManager->arrange(m);
 }
 
 // Toggle layout
@@ -100,24 +84,23 @@ void toggleLayout() {
     Monitor* m = g_windowManager->getCurrentMonitor();
     if (!m) return;
     
-    LayoutType temp = m->currentLayout;
-    m->currentLayout = m->previousLayout;
-    m->previousLayout = temp;
+    LayoutType temp = m->tag().layout;
+    m->tag().layout = m->tag().previousLayout;
+    m->tag().previousLayout = temp;
     
-    arrange(m);
+    g_windowManager->arrange(m);
 }
 
-// Arrange windows
+// Arrange windows immediately. Callers outside the batch flush should go
+// through WindowManager::arrange(), which defers the work.
 void arrange(Monitor* m) {
     if (!g_windowManager) return;
     
     if (m) {
-        showHide(m->tags[m->selectedTag].clients.size() > 0 ? 
-                 m->tags[m->selectedTag].clients[0] : nullptr);
+        showHide(m->clients);
     } else {
         for (size_t i = 0; i < g_windowManager->monitors.size(); i++) {
-            showHide(g_windowManager->monitors[i].tags[g_windowManager->monitors[i].selectedTag].clients.size() > 0 ? 
-                     g_windowManager->monitors[i].tags[g_windowManager->monitors[i].selectedTag].clients[0] : nullptr);
+            showHide(g_windowManager->monitors[i].clients);
         }
     }
     
@@ -136,7 +119,7 @@ void arrange(Monitor* m) {
 void arrangeMon(Monitor* m) {
     if (!m) return;
     
-    switch (m->currentLayout) {
+    switch (m->tag().layout) {
         case LayoutType::TILED:
             tileLayout(m);
             break;
@@ -149,28 +132,175 @@ void arrangeMon(Monitor* m) {
     }
 }
 
-// Restack windows
+// Scratch space for restack(), reused
+static std::vector<Window> order;
+
+// True if sub appears in seq in the same relative order
+static bool isSubsequence(const Window* sub, size_t nsub, const Window* seq, size_t nseq) {
+    size_t j = 0;
+    for (size_t i = 0; i < nsub; i++) {
+        while (j < nseq && seq[j] != sub[i]) j++;
+        if (j++ == nseq) return false;
+    }
+    return true;
+}
+
+// Bring the monitor's windows into stacking order with one XRestackWindows
+// call. Top to bottom: fullscreen clients, the focused client if it
+// floats, other floating clients, the bar, then the tiled clients. Tiled
+// clients only overlap in monocle, where the focused one goes first;
+// otherwise they keep list order so focus changes do not restack them.
+// Only the part of the order that changed since the last call is sent,
+// and nothing at all if the order only lost windows.
 void restack(Monitor* m) {
     if (!m) return;
-    
-    // TODO: Implement window restacking
+
+    WindowManager* wm = g_windowManager;
+    Client* sel = wm->getFocusedClient();
+    bool floating = m->tag().layout == LayoutType::FLOATING;
+    bool monocle = m->tag().layout == LayoutType::MONOCLE;
+
+    if (sel && sel->mon != m) {
+        sel = nullptr;
+    }
+
+    order.clear();
+    for (Client* c = m->clients; c; c = c->next) {
+        if (ISVISIBLE(c) && c->isfullscreen) order.push_back(c->window);
+    }
+    if (sel && !sel->isfullscreen && (sel->isfloating || floating)) {
+        order.push_back(sel->window);
+    }
+    for (Client* c = m->clients; c; c = c->next) {
+        if (ISVISIBLE(c) && !c->isfullscreen && (c->isfloating || floating) && c != sel) {
+            order.push_back(c->window);
+        }
+    }
+    if (m->barwin && m->showbar) {
+        order.push_back(m->barwin);
+    }
+    if (!floating) {
+        Client* top = (monocle && sel && !sel->isfullscreen && !sel->isfloating) ? sel : nullptr;
+        if (top) {
+            order.push_back(top->window);
+        }
+        for (Client* c = m->clients; c; c = c->next) {
+            if (ISVISIBLE(c) && !c->isfullscreen && !c->isfloating && c != top) {
+                order.push_back(c->window);
+            }
+        }
+    }
+
+    // Windows before the first difference are already in place
+    unsigned long sent = 0;
+    size_t k = 0;
+    while (k < order.size() && k < m->stack.size() && order[k] == m->stack[k]) k++;
+
+    if (isSubsequence(order.data() + k, order.size() - k,
+                      m->stack.data() + k, m->stack.size() - k)) {
+        wm->restackStats.skipped++;
+    } else {
+        // XRestackWindows leaves its first window where it is and stacks
+        // each following one under the previous, so start one above k
+        size_t first = k ? k - 1 : 0;
+        size_t n = order.size() - first;
+        if (n > 1) {
+            XRestackWindows(wm->display, order.data() + first, n);
+            sent = n - 1;
+            wm->restackStats.restacks++;
+            wm->restackStats.requests += sent;
+        }
+    }
+    wm->restackStats.saved += order.size() - sent;
+    m->stack.swap(order);
 }
 
-// Update bar position
+// Update bar position and the window area it leaves
 void updateBarPos(Monitor* m) {
     if (!m) return;
     
-    // TODO: Implement bar position update
+    int bh = g_windowManager->bh;
+
+    m->wx = m->x;
+    m->ww = m->width;
+    m->wy = m->y;
+    m->wh = m->height;
+    if (m->showbar) {
+        m->wh -= bh;
+        m->by = TOP_BAR ? m->wy : m->wy + m->wh;
+        m->wy = TOP_BAR ? m->wy + bh : m->wy;
+    } else {
+        m->by = -bh;
+    }
 }
 
-// Update bars
+// Create bar windows and back buffers for monitors that lack them
 void updateBars() {
-    // TODO: Implement bars update
+    WindowManager* wm = g_windowManager;
+    Display* dpy = wm->display;
+    XSetWindowAttributes wa;
+
+    wa.override_redirect = True;
+    wa.background_pixmap = ParentRelative;
+    wa.event_mask = ButtonPressMask | ExposureMask;
+
+    for (Monitor& m : wm->monitors) {
+        if (!m.barwin) {
+            m.barwin = XCreateWindow(dpy, wm->root, m.wx, m.by, m.ww, wm->bh, 0,
+                                     DefaultDepth(dpy, wm->screen), CopyFromParent,
+                                     DefaultVisual(dpy, wm->screen),
+                                     CWOverrideRedirect | CWBackPixmap | CWEventMask, &wa);
+            XDefineCursor(dpy, m.barwin, wm->cursors[0]);
+            XMapRaised(dpy, m.barwin);
+        }
+        if (m.barbuf) continue;
+
+        // A new buffer (after a resize, say) starts out empty
+        m.barbuf = XCreatePixmap(dpy, wm->root, m.ww, wm->bh, DefaultDepth(dpy, wm->screen));
+        m.bardraw = XftDrawCreate(dpy, m.barbuf, DefaultVisual(dpy, wm->screen),
+                                  DefaultColormap(dpy, wm->screen));
+        invalidateBar(&m);
+    }
 }
 
-// Show/hide client
+// Show the visible clients of a list and hide the rest.
+//
+// Hidden windows are either parked offscreen, staying mapped so their
+// clients need not repaint or resend anything when shown again, or
+// unmapped (hideByUnmap). WM_STATE follows: a parked window is still
+// viewable and stays NormalState, an unmapped one becomes IconicState.
+// Positions go through the geometry last sent, so a window already parked
+// or already in place costs nothing, and all the moves leave in the same
+// flush. Visible tiled clients are left where they are; the layout pass
+// right after this puts them in place with a single configure.
 void showHide(Client* c) {
-    if (!c) return;
-    
-    // TODO: Implement client show/hide
+    WindowManager* wm = g_windowManager;
+
+    for (; c; c = c->next) {
+        if (ISVISIBLE(c)) {
+            if (c->wmstate != NormalState) {
+                XMapWindow(wm->display, c->window);
+                setClientState(c, NormalState);
+            }
+            bool tiled = !c->isfloating && !c->isfullscreen &&
+                         c->mon->tag().layout != LayoutType::FLOATING;
+            if (!tiled) {
+                moveClientWindow(c, c->x, c->y);
+            }
+        } else if (wm->hideByUnmap) {
+            // A window adopted onto a hidden tag was never mapped
+            if (c->wmstate == NormalState) {
+                c->ignoreUnmap++;
+                XUnmapWindow(wm->display, c->window);
+            }
+            setClientState(c, IconicState);
+        } else {
+            moveClientWindow(c, -2 * WIDTH(c), c->y);
+            // Unmapped before the mode changed, or never mapped
+            if (c->wmstate != NormalState) {
+                XMapWindow(wm->display, c->window);
+                setClientState(c, NormalState);
+            }
+        }
+    }
 }
@@ -0,0 +1,257 @@
+#include "monitor.h"
+#include "layout.h"
+#include "window.h"
+#include <algorithm>
+#ifdef XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif
+#ifdef XINERAMA
+#include <X11/extensions/Xinerama.h>
+#endif
+
+// Head geometry as reported by the server
+struct Head {
+    int x, y, w, h;
+
+    bool operator==(const Head& o) const { return x == o.x && y == o.y && w == o.w && h == o.h; }
+};
+
+// Grid over the distinct monitor edges. A point is found with one binary
+// search per axis; cells holds the monitor covering each grid cell, or -1.
+static std::vector<int> xs, ys;
+static std::vector<int> cells;
+
+#ifdef XRANDR
+static int randrEventBase = -1;
+#endif
+
+static void queryHeads(std::vector<Head>& heads) {
+    heads.clear();
+#ifdef XRANDR
+    Display* dpy = g_windowManager->display;
+    int event, error, nmon = 0;
+    if (XRRQueryExtension(dpy, &event, &error)) {
+        XRRMonitorInfo* info = XRRGetMonitors(dpy, g_windowManager->root, True, &nmon);
+        for (int i = 0; i < nmon; i++) {
+            heads.push_back({ info[i].x, info[i].y, info[i].width, info[i].height });
+        }
+        if (info) {
+            XRRFreeMonitors(info);
+        }
+    }
+#endif
+#ifdef XINERAMA
+    if (heads.empty() && XineramaIsActive(g_windowManager->display)) {
+        int n = 0;
+        XineramaScreenInfo* info = XineramaQueryScreens(g_windowManager->display, &n);
+        for (int i = 0; i < n; i++) {
+            heads.push_back({ info[i].x_org, info[i].y_org, info[i].width, info[i].height });
+        }
+        if (info) {
+            XFree(info);
+        }
+    }
+#endif
+
+    // Cloned outputs report the same head twice
+    std::vector<Head> unique;
+    for (const Head& h : heads) {
+        if (h.w > 0 && h.h > 0 && std::find(unique.begin(), unique.end(), h) == unique.end()) {
+            unique.push_back(h);
+        }
+    }
+    heads.swap(unique);
+
+    if (heads.empty()) {
+        heads.push_back({ 0, 0, g_windowManager->screenWidth, g_windowManager->screenHeight });
+    }
+}
+
+static void initMonitor(Monitor& m, int num) {
+    m.num = num;
+    m.showbar = SHOW_BAR;
+    m.barwin = None;
+    m.barbuf = None;
+    m.bardraw = nullptr;
+    m.clients = nullptr;
+    m.tagset = 1;
+    m.selectedTag = 0;
+    m.previousTag = 0;
+    m.dirty = true;
+    m.stackDirty = false;
+    m.stack.clear();
+    m.tags.clear();
+    for (int i = 0; i < NUM_TAGS; i++) {
+        Tag tag;
+        tag.name = TAGS[i];
+        tag.layout = LayoutType::TILED;
+        tag.previousLayout = LayoutType::TILED;
+        tag.mfact = MASTER_FACTOR;
+        tag.nmaster = NUM_MASTER;
+        tag.geometry.valid = false;
+        tag.focusStack = nullptr;
+        m.tags.push_back(tag);
+    }
+}
+
+static void buildIndex() {
+    const auto& monitors = g_windowManager->monitors;
+
+    xs.clear();
+    ys.clear();
+    for (const Monitor& m : monitors) {
+        xs.push_back(m.x);
+        xs.push_back(m.x + m.width);
+        ys.push_back(m.y);
+        ys.push_back(m.y + m.height);
+    }
+    std::sort(xs.begin(), xs.end());
+    xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+    size_t nx = xs.size() - 1;
+    cells.assign(nx * (ys.size() - 1), -1);
+
+    // Earlier monitors win where heads overlap
+    for (size_t i = monitors.size(); i-- > 0;) {
+        const Monitor& m = monitors[i];
+        size_t x0 = std::lower_bound(xs.begin(), xs.end(), m.x) - xs.begin();
+        size_t x1 = std::lower_bound(xs.begin(), xs.end(), m.x + m.width) - xs.begin();
+        size_t y0 = std::lower_bound(ys.begin(), ys.end(), m.y) - ys.begin();
+        size_t y1 = std::lower_bound(ys.begin(), ys.end(), m.y + m.height) - ys.begin();
+        for (size_t y = y0; y < y1; y++) {
+            std::fill(cells.begin() + y * nx + x0, cells.begin() + y * nx + x1, i);
+        }
+    }
+}
+
+Monitor* monitorAt(int x, int y) {
+    auto ix = std::upper_bound(xs.begin(), xs.end(), x) - xs.begin() - 1;
+    auto iy = std::upper_bound(ys.begin(), ys.end(), y) - ys.begin() - 1;
+    size_t nx = xs.size() - 1;
+
+    if (ix < 0 || iy < 0 || static_cast<size_t>(ix) >= nx ||
+        static_cast<size_t>(iy) >= ys.size() - 1) {
+        return nullptr;
+    }
+    int i = cells[iy * nx + ix];
+    return i < 0 ? nullptr : &g_windowManager->monitors[i];
+}
+
+static void destroyBar(Monitor& m) {
+    Display* dpy = g_windowManager->display;
+
+    if (m.bardraw) {
+        XftDrawDestroy(m.bardraw);
+        m.bardraw = nullptr;
+    }
+    if (m.barbuf) {
+        XFreePixmap(dpy, m.barbuf);
+        m.barbuf = None;
+    }
+    if (m.barwin) {
+        XUnmapWindow(dpy, m.barwin);
+        XDestroyWindow(dpy, m.barwin);
+        m.barwin = None;
+    }
+}
+
+bool updateGeometry() {
+    WindowManager* wm = g_windowManager;
+    auto& monitors = wm->monitors;
+    std::vector<Head> heads;
+    bool changed = false;
+
+    queryHeads(heads);
+
+    // Monitors live in a deque, so adding and removing at the end keeps
+    // every Client::mon pointer to the others valid
+    while (monitors.size() < heads.size()) {
+        monitors.emplace_back();
+        initMonitor(monitors.back(), monitors.size() - 1);
+        monitors.back().width = 0;  // Forces the geometry update below
+        changed = true;
+    }
+
+    while (monitors.size() > heads.size()) {
+        Monitor& gone = monitors.back();
+        Monitor* first = &monitors[0];
+
+        while (Client* c = gone.clients) {
+            detachClient(c);
+            detachStack(c);
+            c->mon = first;
+            attachClient(c);
+            attachStack(c);
+        }
+        destroyBar(gone);
+        monitors.pop_back();
+        first->dirty = true;
+        changed = true;
+    }
+
+    for (size_t i = 0; i < heads.size(); i++) {
+        Monitor& m = monitors[i];
+        const Head& h = heads[i];
+        if (m.x == h.x && m.y == h.y && m.width == h.w && m.height == h.h) continue;
+
+        bool widthChanged = m.width != h.w;
+        m.x = h.x;
+        m.y = h.y;
+        m.width = h.w;
+        m.height = h.h;
+        updateBarPos(&m);
+        m.dirty = true;
+        changed = true;
+
+        if (m.barwin) {
+            XMoveResizeWindow(wm->display, m.barwin, m.wx, m.by, m.ww, wm->bh);
+            if (widthChanged) {
+                // The back buffer is sized to the bar; updateBars() makes a new one
+                XftDrawDestroy(m.bardraw);
+                XFreePixmap(wm->display, m.barbuf);
+                m.bardraw = nullptr;
+                m.barbuf = None;
+            }
+        }
+    }
+
+    if (wm->currentMonitor >= static_cast<int>(monitors.size())) {
+        wm->currentMonitor = 0;
+    }
+    if (changed) {
+        buildIndex();
+    }
+    return changed;
+}
+
+void selectScreenChanges() {
+#ifdef XRANDR
+    int error;
+    if (XRRQueryExtension(g_windowManager->display, &randrEventBase, &error)) {
+        XRRSelectInput(g_windowManager->display, g_windowManager->root, RRScreenChangeNotifyMask);
+    } else {
+        randrEventBase = -1;
+    }
+#endif
+}
+
+bool handleScreenChange(XEvent* ev) {
+#ifdef XRANDR
+    if (randrEventBase >= 0 && ev->type == randrEventBase + RRScreenChangeNotify) {
+        WindowManager* wm = g_windowManager;
+        XRRUpdateConfiguration(ev);
+        wm->screenWidth = DisplayWidth(wm->display, wm->screen);
+        wm->screenHeight = DisplayHeight(wm->display, wm->screen);
+        if (updateGeometry()) {
+            updateBars();
+            wm->focusClient(nullptr);
+        }
+        return true;
+    }
+#else
+    (void)ev;
+#endif
+    return false;
+}
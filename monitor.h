@@ -0,0 +1,25 @@
+#pragma once
+
+#include "nwm.h"
+
+// Monitor discovery and the pointer-to-monitor index.
+//
+// Heads come from RandR 1.5 monitors when built with -DXRANDR, otherwise
+// from Xinerama with -DXINERAMA (duplicates from cloned outputs dropped),
+// otherwise the whole screen is one monitor. On a change the first
+// monitors keep their state and only get new geometry; surplus monitors
+// hand their clients to the first one.
+
+// Query the heads and bring monitors in line. Returns true if any monitor
+// was added, removed or moved.
+bool updateGeometry();
+
+// Monitor containing a root coordinate, or nullptr in the gaps between
+// heads. O(log n) in the number of monitors.
+Monitor* monitorAt(int x, int y);
+
+// Select RandR screen change events if the extension is there
+void selectScreenChanges();
+
+// Handle an extension event; false if it was not a screen change
+bool handleScreenChange(XEvent* ev);
@@ -1,6 +1,15 @@
 #include "nwm.h"
 #include "window.h"
 #include "layout.h"
+#include "xquery.h"
+#include "bar.h"
+#include "status.h"
+#include "ipc.h"
+#include "profile.h"
+#include "monitor.h"
+#include "restart.h"
+#include "rules.h"
+#include "keys.h"
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
 #include <X11/Xutil.h>
@@ -8,10 +17,17 @@
 #include <X11/XF86keysym.h>
 #include <X11/cursorfont.h>
 #include <X11/Xft/Xft.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <clocale>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <iostream>
 #include <unistd.h>
+#include <poll.h>
 #include <signal.h>
 #include <sys/wait.h>
 
@@ -20,30 +36,76 @@ WindowManager* g_windowManager = nullptr;
 
 // Event handler function pointers
 typedef void (WindowManager::*EventHandler)(XEvent*);
-static EventHandler eventHandlers[LASTEvent] = {
-    [ButtonPress] = &WindowManager::handleButtonPress,
-    [ClientMessage] = &WindowManager::handleClientMessage,
-    [ConfigureRequest] = &WindowManager::handleConfigureRequest,
-    [ConfigureNotify] = &WindowManager::handleConfigureNotify,
-    [DestroyNotify] = &WindowManager::handleDestroyNotify,
-    [EnterNotify] = &WindowManager::handleEnterNotify,
-    [Expose] = &WindowManager::handleExpose,
-    [FocusIn] = &WindowManager::handleFocusIn,
-    [KeyPress] = &WindowManager::handleKeyPress,
-    [MappingNotify] = &WindowManager::handleMappingNotify,
-    [MapRequest] = &WindowManager::handleMapRequest,
-    [MotionNotify] = &WindowManager::handleMotionNotify,
-    [PropertyNotify] = &WindowManager::handlePropertyNotify,
-    [UnmapNotify] = &WindowManager::handleUnmapNotify
+static const std::array<EventHandler, LASTEvent> eventHandlers = [] {
+    std::array<EventHandler, LASTEvent> h{};
+    h[ButtonPress] = &WindowManager::handleButtonPress;
+    h[ClientMessage] = &WindowManager::handleClientMessage;
+    h[ConfigureRequest] = &WindowManager::handleConfigureRequest;
+    h[ConfigureNotify] = &WindowManager::handleConfigureNotify;
+    h[DestroyNotify] = &WindowManager::handleDestroyNotify;
+    h[EnterNotify] = &WindowManager::handleEnterNotify;
+    h[Expose] = &WindowManager::handleExpose;
+    h[FocusIn] = &WindowManager::handleFocusIn;
+    h[KeyPress] = &WindowManager::handleKeyPress;
+    h[MappingNotify] = &WindowManager::handleMappingNotify;
+    h[MapRequest] = &WindowManager::handleMapRequest;
+    h[MotionNotify] = &WindowManager::handleMotionNotify;
+    h[PropertyNotify] = &WindowManager::handlePropertyNotify;
+    h[UnmapNotify] = &WindowManager::handleUnmapNotify;
+    return h;
+}();
+
+// Atom names, in wmatom[] order followed by netatom[] order
+static const char* atomNames[] = {
+    "WM_PROTOCOLS",
+    "WM_DELETE_WINDOW",
+    "WM_STATE",
+    "WM_TAKE_FOCUS",
+    "_NWM_STATE",
+    "_NET_SUPPORTED",
+    "_NET_WM_NAME",
+    "_NET_WM_STATE",
+    "_NET_WM_CHECK",
+    "_NET_WM_STATE_FULLSCREEN",
+    "_NET_ACTIVE_WINDOW",
+    "_NET_WM_WINDOW_TYPE",
+    "_NET_WM_WINDOW_TYPE_DIALOG",
+    "_NET_CLIENT_LIST"
 };
+static_assert(sizeof(atomNames) / sizeof(atomNames[0]) == WMLast + NetLast,
+              "atomNames[] must match the WM and Net atom enums");
+
+// Path of a per-display runtime file such as the status FIFO
+std::string runtimePath(const char* name) {
+    const char* dir = getenv("XDG_RUNTIME_DIR");
+    const char* dpy = getenv("DISPLAY");
+    std::string path = (dir && *dir) ? dir : "/tmp";
+
+    path += "/";
+    path += name;
+    if (dpy && *dpy) {
+        path += "-";
+        for (const char* p = dpy; *p; p++) {
+            path += (*p == '/') ? '_' : *p;
+        }
+    }
+    return path;
+}
+
+// Milliseconds on the monotonic clock, for profiling
+double monotonicMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
 
 // Key bindings
 static KeyBinding keys[] = {
     { MODKEY, XK_p, [](void* arg) { spawn(MENU_PROGRAM); }, nullptr },
     { MODKEY|ShiftMask, XK_Return, [](void* arg) { spawn(TERMINAL); }, nullptr },
     { MODKEY, XK_b, [](void* arg) { g_windowManager->toggleStatusBar(); }, nullptr },
-    { MODKEY, XK_j, [](void* arg) { /* Focus next window */ }, nullptr },
-    { MODKEY, XK_k, [](void* arg) { /* Focus previous window */ }, nullptr },
+    { MODKEY, XK_j, [](void* arg) { g_windowManager->focusStack(+1); }, nullptr },
+    { MODKEY, XK_k, [](void* arg) { g_windowManager->focusStack(-1); }, nullptr },
     { MODKEY, XK_i, [](void* arg) { g_windowManager->increaseMasterCount(); }, nullptr },
     { MODKEY, XK_d, [](void* arg) { g_windowManager->decreaseMasterCount(); }, nullptr },
     { MODKEY, XK_h, [](void* arg) { g_windowManager->decreaseMasterSize(); }, nullptr },
@@ -71,13 +133,24 @@ static KeyBinding keys[] = {
     TAGKEYS(XK_7, 6),
     TAGKEYS(XK_8, 7),
     TAGKEYS(XK_9, 8),
+    { MODKEY|ShiftMask, XK_r, restart, nullptr },
     { MODKEY|ShiftMask, XK_q, quit, nullptr }
 };
 
+// Key chords, e.g. Mod+a then t
+static KeyChord chords[] = {
+    { { { MODKEY, XK_a }, { 0, XK_t } }, [](void*) { g_windowManager->setLayout(LayoutType::TILED); }, nullptr },
+    { { { MODKEY, XK_a }, { 0, XK_m } }, [](void*) { g_windowManager->setLayout(LayoutType::MONOCLE); }, nullptr },
+    { { { MODKEY, XK_a }, { 0, XK_r } }, restart, nullptr },
+};
+
 // Constructor
 WindowManager::WindowManager()
     : display(nullptr), root(0), screen(0), screenWidth(0), screenHeight(0),
-      currentMonitor(0), focusedClient(nullptr), running(false) {
+      font(nullptr), gc(nullptr), bh(0), lrpad(0),
+      currentMonitor(0), focusedClient(nullptr), hideByUnmap(HIDE_BY_UNMAP), running(false),
+      restarting(false), eventStats(),
+      configureStats(), layoutStats(), restackStats(), startupProfile(), barStats() {
 }
 
 // Destructor
@@ -87,6 +160,8 @@ WindowManager::~WindowManager() {
 
 // Initialize the window manager
 bool WindowManager::initialize() {
+    double start = monotonicMs();
+
     // Open display
     display = XOpenDisplay(nullptr);
     if (!display) {
@@ -108,28 +183,27 @@ bool WindowManager::initialize() {
     });
 
     // Try to select SubstructureRedirectMask on root window
-    XSelectInput(display, root, SubstructureRedirectMask | SubstructureNotifyMask);
+    XSelectInput(display, root, SubstructureRedirectMask | SubstructureNotifyMask |
+                 StructureNotifyMask | PropertyChangeMask | PointerMotionMask | EnterWindowMask);
     XSync(display, False);
+    countRoundTrips();
 
     // Set normal error handler
     XSetErrorHandler([](Display*, XErrorEvent*) -> int { return 0; });
     XSync(display, False);
+    countRoundTrips();
+
+    // Index the rules before the window scan needs them
+    compileRules(RULES, sizeof(RULES) / sizeof(RULES[0]));
 
-    // Initialize atoms
-    wmatom[0] = XInternAtom(display, "WM_PROTOCOLS", False);
-    wmatom[1] = XInternAtom(display, "WM_DELETE_WINDOW", False);
-    wmatom[2] = XInternAtom(display, "WM_STATE", False);
-    wmatom[3] = XInternAtom(display, "WM_TAKE_FOCUS", False);
-
-    netatom[0] = XInternAtom(display, "_NET_SUPPORTED", False);
-    netatom[1] = XInternAtom(display, "_NET_WM_NAME", False);
-    netatom[2] = XInternAtom(display, "_NET_WM_STATE", False);
-    netatom[3] = XInternAtom(display, "_NET_WM_CHECK", False);
-    netatom[4] = XInternAtom(display, "_NET_WM_STATE_FULLSCREEN", False);
-    netatom[5] = XInternAtom(display, "_NET_ACTIVE_WINDOW", False);
-    netatom[6] = XInternAtom(display, "_NET_WM_WINDOW_TYPE", False);
-    netatom[7] = XInternAtom(display, "_NET_WM_WINDOW_TYPE_DIALOG", False);
-    netatom[8] = XInternAtom(display, "_NET_CLIENT_LIST", False);
+    // Initialize atoms: one InternAtoms request for the whole table
+    double atomsStart = monotonicMs();
+    Atom atoms[WMLast + NetLast];
+    XInternAtoms(display, const_cast<char**>(atomNames), WMLast + NetLast, False, atoms);
+    countRoundTrips();
+    std::copy(atoms, atoms + WMLast, wmatom);
+    std::copy(atoms + WMLast, atoms + WMLast + NetLast, netatom);
+    startupProfile.atoms = monotonicMs() - atomsStart;
 
     // Initialize cursors
     cursors[0] = XCreateFontCursor(display, XC_left_ptr);
@@ -160,37 +234,30 @@ bool WindowManager::initialize() {
     XftColorAllocName(display, DefaultVisual(display, screen), cmap, COLOR_BORDER_SELECTED, &color);
     colors[1][2] = color; // SchemeSel border
 
+    // Initialize bar font and drawing state
+    font = XftFontOpenName(display, screen, FONT);
+    if (!font) {
+        std::cerr << "nwm: cannot load font " << FONT << std::endl;
+        return false;
+    }
+    gc = XCreateGC(display, root, 0, nullptr);
+    bh = MAX(BAR_HEIGHT, font->ascent + font->descent + 2);
+    lrpad = font->ascent + font->descent;
+    statusText = "nwm-" VERSION;
+
     // Initialize layouts
     layouts.push_back(Layout("[]=" , tileLayout));
     layouts.push_back(Layout("><>", nullptr));
     layouts.push_back(Layout("[M]", monocleLayout));
 
-    // Initialize monitors
-    // TODO: Initialize monitors with Xinerama if available
-    Monitor m;
-    m.x = 0;
-    m.y = 0;
-    m.width = screenWidth;
-    m.height = screenHeight;
-    m.selectedTag = 0;
-    m.previousTag = 0;
-    m.currentLayout = LayoutType::TILED;
-    m.previousLayout = LayoutType::TILED;
-    m.mfact = MASTER_FACTOR;
-    m.nmaster = NUM_MASTER;
-
-    // Initialize tags
-    for (int i = 0; i < NUM_TAGS; i++) {
-        Tag tag;
-        tag.name = TAGS[i];
-        tag.visible = (i == 0);
-        m.tags.push_back(tag);
-    }
-
-    monitors.push_back(m);
+    // Initialize monitors, one per head, and pick up the state a restart
+    // left behind
+    updateGeometry();
+    selectScreenChanges();
+    bool restoring = loadState();
 
     // Create status bar
-    // TODO: Create status bar
+    updateBars();
 
     // Grab keys
     grabKeys();
@@ -198,26 +265,62 @@ bool WindowManager::initialize() {
     // Grab buttons
     grabButtons();
 
-    // Scan for existing windows
+    // Scan for existing windows. The queries for every child are pipelined,
+    // so the server is only grabbed for a couple of round trips
+    double scanStart = monotonicMs();
     XGrabServer(display);
+    countGrab();
     Window root_return, parent_return;
-    Window* children;
-    unsigned int nchildren;
+    Window* children = nullptr;
+    unsigned int nchildren = 0;
+    std::vector<WindowInfo> infos;
 
+    countRoundTrips();
     if (XQueryTree(display, root, &root_return, &parent_return, &children, &nchildren)) {
-        for (unsigned int i = 0; i < nchildren; i++) {
-            XWindowAttributes wa;
-            if (XGetWindowAttributes(display, children[i], &wa) &&
-                wa.override_redirect == False && wa.map_state == IsViewable) {
-                manageClient(children[i], &wa);
-            }
-        }
+        queryWindows(children, nchildren, infos);
         if (children) {
             XFree(children);
         }
     }
 
+    // Send the ungrab now; left in the buffer it would hold the server
+    // through the adoption pass below
     XUngrabServer(display);
+    XFlush(display);
+    startupProfile.grab = monotonicMs() - scanStart;
+
+    // Adopt in one pass, normal windows before transients so the latter
+    // find their parent. The single arrange happens in run().
+    for (int transients = 0; transients < 2; transients++) {
+        for (const WindowInfo& info : infos) {
+            if (!info.valid || info.attrs.override_redirect ||
+                (info.transientFor != None) != (transients == 1)) {
+                continue;
+            }
+            if (info.attrs.map_state == IsViewable || info.state == IconicState) {
+                manageClient(info);
+                startupProfile.adopted++;
+            }
+        }
+    }
+    if (restoring) {
+        finishRestore();
+    }
+    startupProfile.scan = monotonicMs() - scanStart;
+
+    // Status input; the root window name keeps working without it
+    openStatusFifo();
+
+    // Control socket; keybindings keep working without it
+    openIpc();
+    installProfileSignal();
+
+    startupProfile.total = monotonicMs() - start;
+    fprintf(stderr, "nwm: startup %.2f ms (atoms %.2f ms, %d atoms; "
+            "scan %.2f ms, %u of %u windows adopted, %u restored; server grabbed %.2f ms)\n",
+            startupProfile.total, startupProfile.atoms, WMLast + NetLast,
+            startupProfile.scan, startupProfile.adopted, nchildren, startupProfile.restored,
+            startupProfile.grab);
 
     return true;
 }
@@ -225,18 +328,115 @@ bool WindowManager::initialize() {
 // Main event loop
 void WindowManager::run() {
     XEvent ev;
+    std::vector<struct pollfd> pfds;
+    int configureWait = -1;  // Until a rate-limited configure reply is due
     running = true;
 
-    while (running && !XNextEvent(display, &ev)) {
-        if (eventHandlers[ev.type]) {
-            (this->*eventHandlers[ev.type])(&ev);
+    // Lay out whatever was adopted during initialization
+    flushArrange();
+    drawBars();
+
+    while (running) {
+        // Sleep until the server, a status writer or a control client has
+        // something for us. XPending also reads any replies off the socket
+        // for pollReplies(); with work already queued, only check the others.
+        bool busy = XPending(display) || pollReplies();
+        pfds.clear();
+        pfds.push_back({ ConnectionNumber(display), POLLIN, 0 });
+        pfds.push_back({ statusFifoFd(), POLLIN, 0 });
+        size_t nipc = ipcPollFds(pfds);
+        if (poll(pfds.data(), pfds.size(), busy ? 0 : configureWait) < 0 && errno != EINTR) {
+            std::cerr << "nwm: poll failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        if (pfds[1].revents & POLLIN) {
+            readStatusFifo();
+        }
+        // Commands only mark monitors dirty; they are arranged with the batch
+        handleIpc(&pfds[2], nipc);
+        if (profileDumpRequested()) {
+            std::string out;
+            profileDump(out);
+            fputs(out.c_str(), stderr);
+        }
+        pollReplies();
+
+        // Take everything already queued, up to a limit so a client
+        // flooding the server cannot keep the other inputs waiting
+        eventBatch.clear();
+        while (eventBatch.size() < EVENT_BATCH_MAX && XPending(display)) {
+            XNextEvent(display, &ev);
+            eventBatch.push_back(ev);
+        }
+
+        if (!eventBatch.empty()) {
+            coalesceEvents();
+        }
+
+        for (XEvent& e : eventBatch) {
+            if (!running) break;
+            if (e.type == 0) continue;  // Folded into a later event
+            handleEvent(&e);
+            eventStats.dispatched++;
+        }
+
+        flushArrange();
+        configureWait = flushConfigures();
+        drawBars();
+    }
+}
+
+// Fold redundant events in the current batch down to the latest one.
+// Motion and configure notifications are keyed by window, property
+// notifications by window and atom. Input events act as a barrier so a
+// drag is never folded across the button press or release that bounds it.
+void WindowManager::coalesceEvents() {
+    unsigned int dropped = 0;
+
+    coalesceKeys.clear();
+    for (size_t i = eventBatch.size(); i-- > 0;) {
+        XEvent& e = eventBatch[i];
+        unsigned long long key;
+
+        switch (e.type) {
+            case MotionNotify:
+                key = e.xmotion.window;
+                break;
+            case ConfigureNotify:
+                key = e.xconfigure.window;
+                break;
+            case PropertyNotify:
+                key = (static_cast<unsigned long long>(e.xproperty.atom) << 35) | e.xproperty.window;
+                break;
+            case ButtonPress:
+            case ButtonRelease:
+            case KeyPress:
+            case KeyRelease:
+                coalesceKeys.clear();
+                continue;
+            default:
+                continue;
+        }
+
+        // XIDs and atoms fit in 29 bits; the event type sits between them
+        key |= static_cast<unsigned long long>(e.type) << 29;
+        if (!coalesceKeys.insert(key).second) {
+            e.type = 0;
+            dropped++;
         }
     }
+
+    eventStats.batches++;
+    eventStats.received += eventBatch.size();
+    eventStats.coalesced += dropped;
+    eventStats.lastReceived = eventBatch.size();
+    eventStats.lastCoalesced = dropped;
 }
 
 // Clean up resources
 void WindowManager::cleanup() {
-    // TODO: Implement cleanup
+    closeIpc();
+    closeStatusFifo();
     if (display) {
         XCloseDisplay(display);
         display = nullptr;
@@ -244,10 +444,13 @@ void WindowManager::cleanup() {
 }
 
 // Manage a new client window
-void WindowManager::manageClient(Window win, XWindowAttributes* wa) {
+void WindowManager::manageClient(const WindowInfo& info) {
+    Window win = info.window;
+    const XWindowAttributes* wa = &info.attrs;
+    Client* t;
+
     // Create new client
-    auto client = std::make_unique<Client>(win);
-    Client* c = client.get();
+    Client* c = clientPool.create(win);
 
     // Set client properties
     c->x = wa->x;
@@ -258,17 +461,49 @@ void WindowManager::manageClient(Window win, XWindowAttributes* wa) {
     c->oldy = wa->y;
     c->oldwidth = wa->width;
     c->oldheight = wa->height;
+    c->srvx = wa->x;
+    c->srvy = wa->y;
+    c->srvwidth = wa->width;
+    c->srvheight = wa->height;
+    c->srvbw = wa->border_width;
     c->bw = BORDER_PX;
-    c->mon = getCurrentMonitor();
+    // WM_NAME came with the batch; _NET_WM_NAME is read once it is shown
+    if (info.name.empty()) {
+        setTitle(c->name, "broken", 6);
+    } else {
+        setTitle(c->name, info.name.data(), info.name.size());
+    }
+    c->titleStale = true;
 
-    // Update window attributes
-    XSetWindowBorder(display, win, 0);
+    // Transients follow their parent
+    if (info.transientFor != None && (t = getClientByWindow(info.transientFor))) {
+        c->mon = t->mon;
+        c->tags = t->tags;
+        c->isfloating = true;
+    } else {
+        c->mon = getCurrentMonitor();
+        c->tags = c->mon->tagset;
 
-    // Update window title
-    updateTitle(c);
+        // Apply rules
+        applyRules(c, info);
+    }
 
-    // Apply rules
-    applyRules(c);
+    // After a restart the window gets back what it had instead
+    bool restored = restoreClient(c);
+    if (restored) {
+        startupProfile.restored++;
+    }
+    c->wmstate = (info.state >= 0) ? info.state : WithdrawnState;
+
+    // WM hints came with the rest of the batch
+    c->neverfocus = (info.hintFlags & InputHint) && !info.input;
+    c->protocols = info.protocols;
+    c->isurgent = (info.hintFlags & XUrgencyHint) != 0;
+
+    // Update window attributes
+    XSetWindowBorder(display, win, 0);
+    XSelectInput(display, win, EnterWindowMask | FocusChangeMask |
+                 PropertyChangeMask | StructureNotifyMask);
 
     // Update size hints
     updateSizeHints(c);
@@ -276,20 +511,29 @@ void WindowManager::manageClient(Window win, XWindowAttributes* wa) {
     // Update window type
     updateWindowType(c);
 
-    // Update WM hints
-    updateWMHints(c);
-
-    // Map the window
-    XMapWindow(display, win);
+    // Map the window, unless it belongs to a hidden tag (restored there,
+    // or sent there by a rule); showHide() parks or unmaps those
+    if (ISVISIBLE(c)) {
+        XMapWindow(display, win);
+        setClientState(c, NormalState);
+    } else if (info.state < 0 && wa->map_state == IsViewable) {
+        // Mapped but never given WM_STATE (first start over running
+        // clients): record that, so showHide() unmaps it all the same
+        setClientState(c, NormalState);
+    }
 
     // Add to client list
-    clients[win] = std::move(client);
+    clients.insert(win, c);
 
     // Attach to monitor
     attachClient(c);
+    attachStack(c);
 
-    // Focus the client
-    focusClient(c);
+    // Focus the client if it is in view, else keep the visible selection;
+    // restored focus is settled by finishRestore()
+    if (!restored) {
+        focusClient(ISVISIBLE(c) ? c : nullptr);
+    }
 
     // Arrange windows
     arrange(c->mon);
@@ -304,6 +548,7 @@ void WindowManager::unmanageClient(Client* c, bool destroyed) {
 
     // Detach client from lists
     detachClient(c);
+    detachStack(c);
 
     // If not destroyed, restore window state
     if (!destroyed) {
@@ -312,20 +557,28 @@ void WindowManager::unmanageClient(Client* c, bool destroyed) {
 
         // Unmap window
         XGrabServer(display);
+        countGrab();
         XSetErrorHandler([](Display*, XErrorEvent*) -> int { return 0; });
         XSelectInput(display, w, NoEventMask);
         XUngrabButton(display, AnyButton, AnyModifier, w);
         setClientState(c, WithdrawnState);
         XSync(display, False);
+        countRoundTrips();
         XSetErrorHandler([](Display*, XErrorEvent*) -> int { return 0; });
         XUngrabServer(display);
     }
 
-    // Remove from client map
+    // Remove from client index and release the client; its slot may be
+    // reused right away, so drop any reference to it first
+    bool wasFocused = (c == focusedClient);
+    if (wasFocused) {
+        focusedClient = nullptr;
+    }
     clients.erase(w);
+    clientPool.destroy(c);
 
     // Update focus
-    if (c == focusedClient) {
+    if (wasFocused) {
         focusClient(nullptr);
     }
 
@@ -338,21 +591,15 @@ void WindowManager::unmanageClient(Client* c, bool destroyed) {
 
 // Focus a client
 void WindowManager::focusClient(Client* c) {
-    // If no client is provided, find the first visible client
+    if (c && c->mon != getCurrentMonitor()) {
+        currentMonitor = c->mon->num;
+    }
+
+    // If no client is provided, go back to the most recently focused one
     if (!c) {
         Monitor* m = getCurrentMonitor();
-        if (m && !m->tags[m->selectedTag].clients.empty()) {
-            for (Client* client : m->tags[m->selectedTag].clients) {
-                if (client && !client->isfloating) {
-                    c = client;
-                    break;
-                }
-            }
-
-            // If no tiled client found, use the first one
-            if (!c && !m->tags[m->selectedTag].clients.empty()) {
-                c = m->tags[m->selectedTag].clients[0];
-            }
+        if (m) {
+            c = recentClient(m);
         }
     }
 
@@ -365,29 +612,42 @@ void WindowManager::focusClient(Client* c) {
         // Set border color
         XSetWindowBorder(display, c->window, 0xFF0000); // Red border for focused window
 
-        // Raise window
-        XRaiseWindow(display, c->window);
+        // Restacked with the rest of the batch
+        c->mon->stackDirty = true;
 
         // Set input focus
         if (!c->neverfocus) {
             XSetInputFocus(display, c->window, RevertToPointerRoot, CurrentTime);
-            XChangeProperty(display, root, netatom[5], XA_WINDOW, 32,
+            XChangeProperty(display, root, netatom[NetActiveWindow], XA_WINDOW, 32,
                            PropModeReplace, (unsigned char*)&(c->window), 1);
         }
 
         // Send focus event
-        sendEvent(c, wmatom[3]);
+        sendEvent(c, wmatom[WMTakeFocus]);
 
         // Update focused client
+        promoteStack(c);
         focusedClient = c;
     } else {
         // Focus root window
         XSetInputFocus(display, root, RevertToPointerRoot, CurrentTime);
-        XDeleteProperty(display, root, netatom[5]);
+        XDeleteProperty(display, root, netatom[NetActiveWindow]);
         focusedClient = nullptr;
     }
 }
 
+// Cycle focus through the selected tag's clients in focus order, see
+// cycleStack()
+void WindowManager::focusStack(int dir) {
+    Monitor* m = getCurrentMonitor();
+    if (!m) return;
+
+    Client* c = cycleStack(m, focusedClient, dir);
+    if (c && c != focusedClient) {
+        focusClient(c);
+    }
+}
+
 // Unfocus a client
 void WindowManager::unfocusClient(Client* c, bool setfocus) {
     if (!c) return;
@@ -398,7 +658,7 @@ void WindowManager::unfocusClient(Client* c, bool setfocus) {
     // Reset input focus if needed
     if (setfocus) {
         XSetInputFocus(display, root, RevertToPointerRoot, CurrentTime);
-        XDeleteProperty(display, root, netatom[5]);
+        XDeleteProperty(display, root, netatom[NetActiveWindow]);
     }
 }
 
@@ -407,13 +667,15 @@ void WindowManager::killClient(Client* c) {
     if (!c) return;
 
     // Try to send WM_DELETE_WINDOW message first
-    if (!sendEvent(c, wmatom[1])) {
+    if (!sendEvent(c, wmatom[WMDelete])) {
         // If that fails, kill the client forcefully
         XGrabServer(display);
+        countGrab();
         XSetErrorHandler([](Display*, XErrorEvent*) -> int { return 0; });
         XSetCloseDownMode(display, DestroyAll);
         XKillClient(display, c->window);
         XSync(display, False);
+        countRoundTrips();
         XSetErrorHandler([](Display*, XErrorEvent*) -> int { return 0; });
         XUngrabServer(display);
     }
@@ -437,10 +699,10 @@ void WindowManager::toggleFloating(Client* c) {
         int y = c->mon->y + (c->mon->height - c->height) / 2;
 
         // Move and resize the window
-        XMoveResizeWindow(display, c->window, x, y, c->width, c->height);
+        ::resizeClient(c, x, y, c->width, c->height);
     } else {
         // Restore old position and size
-        XMoveResizeWindow(display, c->window, c->oldx, c->oldy, c->oldwidth, c->oldheight);
+        ::resizeClient(c, c->oldx, c->oldy, c->oldwidth, c->oldheight);
     }
 
     // Rearrange windows
@@ -451,24 +713,16 @@ void WindowManager::toggleFloating(Client* c) {
 void WindowManager::moveClient(Client* c, int x, int y) {
     if (!c) return;
 
-    // Update client coordinates
-    c->x = x;
-    c->y = y;
-
     // Move the window
-    XMoveWindow(display, c->window, x, y);
+    ::resizeClient(c, x, y, c->width, c->height);
 }
 
 // Resize a client
 void WindowManager::resizeClient(Client* c, int width, int height) {
     if (!c) return;
 
-    // Update client dimensions
-    c->width = width;
-    c->height = height;
-
     // Resize the window
-    XResizeWindow(display, c->window, width, height);
+    ::resizeClient(c, c->x, c->y, width, height);
 }
 
 // Toggle fullscreen state of a client
@@ -492,11 +746,10 @@ void WindowManager::toggleFullscreen(Client* c) {
         c->isfloating = 1;
 
         // Resize to monitor size
-        XChangeProperty(display, c->window, netatom[4], XA_ATOM, 32,
-                       PropModeReplace, (unsigned char*)&netatom[4], 1);
-        XMoveResizeWindow(display, c->window, c->mon->x, c->mon->y,
-                         c->mon->width, c->mon->height);
-        XRaiseWindow(display, c->window);
+        XChangeProperty(display, c->window, netatom[NetWMState], XA_ATOM, 32,
+                       PropModeReplace, (unsigned char*)&netatom[NetWMFullscreen], 1);
+        ::resizeClient(c, c->mon->x, c->mon->y, c->mon->width, c->mon->height);
+        c->mon->stackDirty = true;
     } else {
         // Restore previous state
         c->isfloating = c->oldstate;
@@ -507,9 +760,9 @@ void WindowManager::toggleFullscreen(Client* c) {
         c->height = c->oldheight;
 
         // Remove fullscreen property
-        XChangeProperty(display, c->window, netatom[4], XA_ATOM, 32,
+        XChangeProperty(display, c->window, netatom[NetWMState], XA_ATOM, 32,
                        PropModeReplace, (unsigned char*)0, 0);
-        XMoveResizeWindow(display, c->window, c->x, c->y, c->width, c->height);
+        ::resizeClient(c, c->x, c->y, c->width, c->height);
     }
 
     // Rearrange windows
@@ -523,20 +776,18 @@ void WindowManager::viewTag(int tag) {
     Monitor* m = getCurrentMonitor();
     if (!m) return;
 
-    // Don't do anything if the tag is already selected
-    if (m->tags[tag].visible) return;
+    // Don't do anything if the tag is already the only one shown
+    if (m->tagset == (1u << tag)) return;
 
     // Save previous tag
     m->previousTag = m->selectedTag;
 
-    // Hide windows on current tag
-    m->tags[m->selectedTag].visible = false;
-
-    // Show windows on new tag
+    // Show only windows on the new tag
     m->selectedTag = tag;
-    m->tags[m->selectedTag].visible = true;
+    m->tagset = 1u << tag;
 
     // Rearrange windows
+    focusClient(nullptr);
     arrange(m);
 }
 
@@ -547,10 +798,13 @@ void WindowManager::toggleTag(int tag) {
     Monitor* m = getCurrentMonitor();
     if (!m) return;
 
-    // Toggle tag visibility
-    m->tags[tag].visible = !m->tags[tag].visible;
+    // Toggle tag visibility, never leaving the monitor with no tag shown
+    unsigned int newTagset = m->tagset ^ (1u << tag);
+    if (!newTagset) return;
+    m->tagset = newTagset;
 
     // Rearrange windows
+    focusClient(nullptr);
     arrange(m);
 }
 
@@ -567,90 +821,132 @@ void WindowManager::tagClient(Client* c, int tag) {
     // Only proceed if the tags are actually changing
     if (c->tags == newTags) return;
 
-    // Set the new tags
+    // Set the new tags; visibility follows from the mask
+    detachStack(c);
     c->tags = newTags;
-
-    // Update client lists for all tags
-    for (int i = 0; i < NUM_TAGS; i++) {
-        auto& clients = m->tags[i].clients;
-
-        // Check if client should be in this tag
-        bool shouldBeInTag = (c->tags & (1 << i));
-        bool isInTag = (std::find(clients.begin(), clients.end(), c) != clients.end());
-
-        if (shouldBeInTag && !isInTag) {
-            // Add to tag
-            clients.push_back(c);
-        } else if (!shouldBeInTag && isInTag) {
-            // Remove from tag
-            auto it = std::find(clients.begin(), clients.end(), c);
-            if (it != clients.end()) {
-                clients.erase(it);
-            }
-        }
-    }
+    attachStack(c);
 
     // Rearrange windows
+    focusClient(nullptr);
     arrange(m);
 }
 
 // Toggle a client's tag
 void WindowManager::toggleClientTag(Client* c, int tag) {
-    // TODO: Implement client tag toggling
+    if (!c || tag < 0 || tag >= NUM_TAGS) return;
+
+    // A client always keeps at least one tag
+    unsigned int newTags = c->tags ^ (1u << tag);
+    if (!newTags) return;
+
+    detachStack(c);
+    c->tags = newTags;
+    attachStack(c);
+    focusClient(nullptr);
+    arrange(c->mon);
 }
 
 // Set the layout
 void WindowManager::setLayout(LayoutType layout) {
-    // TODO: Implement layout setting
+    Monitor* m = getCurrentMonitor();
+    if (!m || m->tag().layout == layout) return;
+
+    m->tag().previousLayout = m->tag().layout;
+    m->tag().layout = layout;
+    arrange(m);
 }
 
 // Toggle between layouts
 void WindowManager::toggleLayout() {
-    // TODO: Implement layout toggling
+    Monitor* m = getCurrentMonitor();
+    if (!m) return;
+
+    std::swap(m->tag().layout, m->tag().previousLayout);
+    arrange(m);
 }
 
-// Arrange windows
+// Arrange windows. Only marks the monitor (or all monitors) dirty; the
+// layout itself runs once per event batch in flushArrange().
 void WindowManager::arrange(Monitor* m) {
-    // TODO: Implement window arrangement
+    if (m) {
+        m->dirty = true;
+    } else {
+        for (Monitor& mon : monitors) {
+            mon.dirty = true;
+        }
+    }
+}
+
+// Lay out every monitor marked dirty since the last flush
+void WindowManager::flushArrange() {
+    for (Monitor& m : monitors) {
+        if (!m.dirty && !m.stackDirty) continue;
+        ProfileMark mark = profileBegin();
+        if (m.dirty) {
+            ::arrange(&m);
+        } else {
+            restack(&m);
+        }
+        m.dirty = m.stackDirty = false;
+        profileEnd(ProfileArrange, mark);
+    }
 }
 
 // Increase master count
 void WindowManager::increaseMasterCount() {
-    // TODO: Implement master count increase
+    Monitor* m = getCurrentMonitor();
+    if (!m) return;
+
+    m->tag().nmaster++;
+    arrange(m);
 }
 
 // Decrease master count
 void WindowManager::decreaseMasterCount() {
-    // TODO: Implement master count decrease
+    Monitor* m = getCurrentMonitor();
+    if (!m || m->tag().nmaster == 0) return;
+
+    m->tag().nmaster--;
+    arrange(m);
 }
 
 // Increase master size
 void WindowManager::increaseMasterSize() {
-    // TODO: Implement master size increase
+    Monitor* m = getCurrentMonitor();
+    if (!m || m->tag().mfact >= 0.95f) return;
+
+    m->tag().mfact = MIN(m->tag().mfact + 0.05f, 0.95f);
+    arrange(m);
 }
 
 // Decrease master size
 void WindowManager::decreaseMasterSize() {
-    // TODO: Implement master size decrease
+    Monitor* m = getCurrentMonitor();
+    if (!m || m->tag().mfact <= 0.05f) return;
+
+    m->tag().mfact = MAX(m->tag().mfact - 0.05f, 0.05f);
+    arrange(m);
 }
 
 // Update status bar
 void WindowManager::updateStatusBar() {
-    // TODO: Implement status bar update
+    drawBars();
 }
 
 // Toggle status bar
 void WindowManager::toggleStatusBar() {
-    // TODO: Implement status bar toggle
+    Monitor* m = getCurrentMonitor();
+    if (!m) return;
+
+    m->showbar = !m->showbar;
+    updateBarPos(m);
+    XMoveResizeWindow(display, m->barwin, m->wx, m->by, m->ww, bh);
+    arrange(m);
 }
 
 // Get client by window
 Client* WindowManager::getClientByWindow(Window win) {
-    auto it = clients.find(win);
-    if (it != clients.end()) {
-        return it->second.get();
-    }
-    return nullptr;
+    return clients.find(win);
 }
 
 // Get focused client
@@ -666,16 +962,23 @@ Monitor* WindowManager::getCurrentMonitor() {
     return nullptr;
 }
 
-// Get monitor by coordinates
+// Get monitor by coordinates; points between heads belong to the current one
 Monitor* WindowManager::getMonitorByCoord(int x, int y) {
-    // TODO: Implement monitor finding by coordinates
-    return &monitors[0];
+    Monitor* m = monitorAt(x, y);
+    return m ? m : getCurrentMonitor();
 }
 
 // Handle events
 void WindowManager::handleEvent(XEvent* ev) {
+    // Extension events are numbered past the core table
+    if (ev->type >= LASTEvent) {
+        handleScreenChange(ev);
+        return;
+    }
     if (eventHandlers[ev->type]) {
+        ProfileMark mark = profileBegin();
         (this->*eventHandlers[ev->type])(ev);
+        profileEnd(ev->type, mark);
     }
 }
 
@@ -689,23 +992,107 @@ void WindowManager::handleClientMessage(XEvent* ev) {
 }
 
 void WindowManager::handleConfigureRequest(XEvent* ev) {
-    // TODO: Implement configure request handling
+    XConfigureRequestEvent* e = &ev->xconfigurerequest;
+    Client* c = getClientByWindow(e->window);
+
+    // Windows we do not manage get what they ask for
+    if (!c) {
+        XWindowChanges wc;
+        wc.x = e->x;
+        wc.y = e->y;
+        wc.width = e->width;
+        wc.height = e->height;
+        wc.border_width = e->border_width;
+        wc.sibling = e->above;
+        wc.stack_mode = e->detail;
+        XConfigureWindow(display, e->window, e->value_mask, &wc);
+        return;
+    }
+
+    // Only record the request here; the reply goes out once per batch at
+    // most and no faster than the client's rate, see flushConfigures().
+    // Stacking requests are ignored, so the last order sent stays valid.
+    c->flood.requests++;
+    configureStats.requests++;
+    if (e->value_mask & CWBorderWidth) {
+        c->bw = e->border_width;
+        arrange(c->mon);
+    } else if (c->isfloating || c->mon->tag().layout == LayoutType::FLOATING) {
+        Monitor* m = c->mon;
+        if (e->value_mask & CWX) {
+            c->oldx = c->x;
+            c->x = m->x + e->x;
+        }
+        if (e->value_mask & CWY) {
+            c->oldy = c->y;
+            c->y = m->y + e->y;
+        }
+        if (e->value_mask & CWWidth) {
+            c->oldwidth = c->width;
+            c->width = e->width;
+        }
+        if (e->value_mask & CWHeight) {
+            c->oldheight = c->height;
+            c->height = e->height;
+        }
+        // Keep floating clients on their monitor
+        if (c->x + c->width > m->x + m->width && c->isfloating) {
+            c->x = m->x + (m->width / 2 - WIDTH(c) / 2);
+        }
+        if (c->y + c->height > m->y + m->height && c->isfloating) {
+            c->y = m->y + (m->height / 2 - HEIGHT(c) / 2);
+        }
+    }
+    queueConfigure(c);
 }
 
 void WindowManager::handleConfigureNotify(XEvent* ev) {
-    // TODO: Implement configure notify handling
+    XConfigureEvent* e = &ev->xconfigure;
+
+    // The root window is resized when heads are added, removed or moved
+    if (e->window != root) return;
+    screenWidth = e->width;
+    screenHeight = e->height;
+    if (updateGeometry()) {
+        updateBars();
+        focusClient(nullptr);
+    }
 }
 
 void WindowManager::handleDestroyNotify(XEvent* ev) {
-    // TODO: Implement destroy notify handling
+    Client* c = getClientByWindow(ev->xdestroywindow.window);
+    if (c) {
+        unmanageClient(c, true);
+    }
 }
 
 void WindowManager::handleEnterNotify(XEvent* ev) {
-    // TODO: Implement enter notify handling
+    XCrossingEvent* e = &ev->xcrossing;
+
+    if ((e->mode != NotifyNormal || e->detail == NotifyInferior) && e->window != root) return;
+
+    Client* c = getClientByWindow(e->window);
+    Monitor* m = c ? c->mon : getMonitorByCoord(e->x_root, e->y_root);
+    if (m != getCurrentMonitor()) {
+        if (focusedClient) {
+            unfocusClient(focusedClient, true);
+        }
+        currentMonitor = m->num;
+    } else if (!c || c == focusedClient) {
+        return;
+    }
+    focusClient(c);
 }
 
 void WindowManager::handleExpose(XEvent* ev) {
-    // TODO: Implement expose handling
+    XExposeEvent* e = &ev->xexpose;
+
+    if (e->count != 0) return;
+    for (Monitor& m : monitors) {
+        if (m.barwin == e->window) {
+            exposeBar(&m);
+        }
+    }
 }
 
 void WindowManager::handleFocusIn(XEvent* ev) {
@@ -713,31 +1100,109 @@ void WindowManager::handleFocusIn(XEvent* ev) {
 }
 
 void WindowManager::handleKeyPress(XEvent* ev) {
-    // TODO: Implement key press handling
+    dispatchKey(&ev->xkey);
 }
 
+// Keycodes and modifiers moved; the key table is keyed by both
 void WindowManager::handleMappingNotify(XEvent* ev) {
-    // TODO: Implement mapping notify handling
+    XMappingEvent* e = &ev->xmapping;
+
+    XRefreshKeyboardMapping(e);
+    if (e->request == MappingKeyboard || e->request == MappingModifier) {
+        grabKeys();
+    }
 }
 
 void WindowManager::handleMapRequest(XEvent* ev) {
-    // TODO: Implement map request handling
+    XMapRequestEvent* e = &ev->xmaprequest;
+
+    if (getClientByWindow(e->window)) {
+        return;
+    }
+
+    // Managed once the replies are in, without waiting for them here
+    requestWindow(e->window, [](const WindowInfo& info) {
+        WindowManager* wm = g_windowManager;
+        // A second MapRequest may have come in the meantime
+        if (info.valid && !info.attrs.override_redirect && !wm->getClientByWindow(info.window)) {
+            wm->manageClient(info);
+        }
+    });
 }
 
 void WindowManager::handleMotionNotify(XEvent* ev) {
-    // TODO: Implement motion notify handling
+    XMotionEvent* e = &ev->xmotion;
+
+    // Moving across the root window into another head selects it
+    if (e->window != root) return;
+
+    Monitor* m = getMonitorByCoord(e->x_root, e->y_root);
+    if (m != getCurrentMonitor()) {
+        if (focusedClient) {
+            unfocusClient(focusedClient, true);
+        }
+        currentMonitor = m->num;
+        focusClient(nullptr);
+    }
 }
 
 void WindowManager::handlePropertyNotify(XEvent* ev) {
-    // TODO: Implement property notify handling
+    XPropertyEvent* e = &ev->xproperty;
+    Client* c;
+
+    if (e->window == root && e->atom == XA_WM_NAME) {
+        updateStatus();
+        return;
+    }
+    if (!(c = getClientByWindow(e->window))) {
+        return;
+    }
+    if (e->atom == wmatom[WMProtocols]) {
+        // A deleted property reads back empty
+        updateProtocols(c);
+        return;
+    }
+    if (e->state == PropertyDelete) {
+        return;
+    }
+
+    if (e->atom == XA_WM_NAME || e->atom == netatom[NetWMName]) {
+        // Read when the bar next shows it, see updateTitle()
+        c->titleStale = true;
+        titleStats().changes++;
+    } else if (e->atom == XA_WM_HINTS) {
+        updateWMHints(c);
+    }
 }
 
 void WindowManager::handleUnmapNotify(XEvent* ev) {
-    // TODO: Implement unmap notify handling
+    XUnmapEvent* e = &ev->xunmap;
+    Client* c = getClientByWindow(e->window);
+
+    if (!c) return;
+
+    // ICCCM withdraw of a window that is not mapped (IconicState, as
+    // hideByUnmap leaves windows on hidden tags): there is no real unmap,
+    // only this synthetic one sent to root
+    if (e->send_event) {
+        setClientState(c, WithdrawnState);
+        unmanageClient(c, false);
+        return;
+    }
+
+    // Each unmap is reported to the window and to root; act on one copy
+    if (e->event != root) return;
+
+    // Our own unmaps hide the window, they do not withdraw it
+    if (c->ignoreUnmap) {
+        c->ignoreUnmap--;
+        return;
+    }
+    unmanageClient(c, false);
 }
 
 // Utility functions
-void spawn(const char** cmd) {
+void spawn(const char* const* cmd) {
     if (fork() == 0) {
         if (g_windowManager && g_windowManager->display) {
             close(ConnectionNumber(g_windowManager->display));
@@ -758,36 +1223,27 @@ void quit(void* arg) {
 }
 
 void grabKeys() {
-    // TODO: Implement key grabbing
+    bindKeys(keys, sizeof(keys) / sizeof(keys[0]), chords, sizeof(chords) / sizeof(chords[0]));
 }
 
 void grabButtons() {
     // TODO: Implement button grabbing
 }
 
-void updateNumlockMask() {
-    // TODO: Implement numlock mask update
-}
-
+// Read the status text from the root window name
 void updateStatus() {
-    // TODO: Implement status update
-}
-
-void drawBar(Monitor* m) {
-    // TODO: Implement bar drawing
-}
-
-void drawBars() {
-    // TODO: Implement bars drawing
-}
-
-// Layout functions
-void tileLayout(Monitor* m) {
-    // TODO: Implement tile layout
-}
-
-void monocleLayout(Monitor* m) {
-    // TODO: Implement monocle layout
+    WindowManager* wm = g_windowManager;
+
+    requestProperty(wm->root, XA_WM_NAME, AnyPropertyType, 256,
+                    [](Window, Atom, const PropertyReply* reply) {
+        WindowManager* wm = g_windowManager;
+        if (reply && reply->format == 8 && reply->nitems) {
+            wm->statusText.assign(reinterpret_cast<const char*>(reply->data),
+                                  strnlen(reinterpret_cast<const char*>(reply->data), reply->nitems));
+        } else {
+            wm->statusText = "nwm-" VERSION;
+        }
+    });
 }
 
 // Main function
@@ -816,7 +1272,17 @@ int main(int argc, char* argv[]) {
 
     g_windowManager->run();
 
+    // Hand the state to the new binary through the root window
+    bool restarting = g_windowManager->restarting;
+    if (restarting) {
+        saveState();
+    }
     delete g_windowManager;
+    if (restarting) {
+        execvp(argv[0], argv);
+        std::cerr << "nwm: cannot restart " << argv[0] << ": " << strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
 
     return EXIT_SUCCESS;
 }
@@ -5,15 +5,35 @@
 #include <X11/Xutil.h>
 #include <X11/Xft/Xft.h>
 #include <X11/cursorfont.h>
+#include <deque>
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include "config.h"
+#include "pool.h"
+#include "wintable.h"
+#include "geometry.h"
+#include "title.h"
+
+// Helper macros
+#define MIN(A, B)               ((A) < (B) ? (A) : (B))
+#define MAX(A, B)               ((A) > (B) ? (A) : (B))
+#define WIDTH(X)                ((X)->width + 2 * (X)->bw)
+#define HEIGHT(X)               ((X)->height + 2 * (X)->bw)
+#define ISVISIBLE(C)            ((C)->tags & (C)->mon->tagset)
 
 // Forward declarations
 class Client;
 class Layout;
+struct WindowInfo;
+
+// Atoms, interned together at startup (see atomNames[] in nwm.cpp)
+enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMRestartState, WMLast };
+enum { NetSupported, NetWMName, NetWMState, NetWMCheck, NetWMFullscreen,
+       NetActiveWindow, NetWMWindowType, NetWMWindowTypeDialog, NetClientList,
+       NetLast };
 
 // Layout types
 enum class LayoutType {
@@ -22,24 +42,130 @@ enum class LayoutType {
     MONOCLE
 };
 
-// Tag structure
+// The geometry a tag's layout last produced and the input it came from,
+// replayed while the input stays the same
+struct TagGeometry {
+    bool valid;
+    LayoutType layout;
+    LayoutArea area;
+    std::vector<LayoutItem> items;
+    std::vector<Rect> rects;
+};
+
+// A client's place in one tag's focus list
+struct FocusLink {
+    Client* next;  // Focused less recently (the list is circular)
+    Client* prev;
+};
+
+// Tag structure. Each tag keeps its own layout settings.
 struct Tag {
     std::string name;
-    std::vector<Client*> clients;
-    bool visible;
+    LayoutType layout;
+    LayoutType previousLayout;
+    float mfact;    // Master area factor
+    int nmaster;    // Number of windows in master area
+    TagGeometry geometry;
+    Client* focusStack;  // Most recently focused client, see attachStack()
+};
+
+// Status bar segments. Tags, layout symbol and title run left to right;
+// the status text is right-aligned.
+enum { BarTags, BarLayout, BarTitle, BarStatus, BarLast };
+
+// One independently redrawn part of the bar
+struct BarSegment {
+    int x, w;         // Position within the bar
+    std::string key;  // Everything the rendered pixels depend on
 };
 
 // Monitor structure
 struct Monitor {
+    int num;                  // Index in WindowManager::monitors
     int x, y, width, height;  // Monitor geometry
+    int wx, wy, ww, wh;       // Window area (monitor minus bar)
     std::vector<Tag> tags;
-    int selectedTag;
+    Client* clients;          // All clients on this monitor, in order
+    unsigned int tagset;      // Bitmask of visible tags
+    int selectedTag;          // Tag whose layout settings apply
     int previousTag;
-    LayoutType currentLayout;
-    LayoutType previousLayout;
     Window barwin;  // Status bar window
-    float mfact;    // Master area factor
-    int nmaster;    // Number of windows in master area
+    Pixmap barbuf;  // Off-screen back buffer for the bar
+    XftDraw* bardraw;
+    BarSegment barsegs[BarLast];  // What barbuf currently holds
+    int by;         // Bar y position
+    bool showbar;
+    bool dirty;     // Needs a layout pass at the end of the event batch
+    bool stackDirty;             // Needs only a restack at the end of the batch
+    std::vector<Window> stack;   // Stacking order last sent, top first
+
+    Tag& tag() { return tags[selectedTag]; }
+};
+
+// Event loop statistics, accumulated per drained batch
+struct EventStats {
+    unsigned long batches;      // Batches drained from the queue
+    unsigned long received;     // Events read from the server
+    unsigned long dispatched;   // Events handed to a handler
+    unsigned long coalesced;    // Events folded into a later one
+    unsigned int lastReceived;  // Size of the most recent batch
+    unsigned int lastCoalesced; // Events dropped from the most recent batch
+};
+
+// Geometry requests sent to the server versus dropped as no-ops, and
+// ConfigureRequests from clients versus the replies they got
+struct ConfigureStats {
+    unsigned long sent;      // XConfigureWindow calls issued
+    unsigned long avoided;   // Requests matching the last sent geometry
+    unsigned long requests;  // ConfigureRequests from managed clients
+    unsigned long replies;   // Configures and synthetic notifies answering them
+    unsigned long deferred;  // Replies held back by the rate limit
+};
+
+// A client's ConfigureRequests. Requests arriving before the reply is
+// sent merge into it, and replies are rate limited with a token bucket.
+struct ConfigureFlood {
+    bool pending;            // Owes the client a reply
+    double tokens;           // Replies it may get right now
+    double stamp;            // When tokens was last topped up, ms
+    unsigned long requests;  // What it asked for
+    unsigned long replies;   // What it got
+    unsigned long deferred;  // Times its reply was held back
+};
+
+// Layout passes computed versus replayed from a tag's cached geometry
+struct LayoutStats {
+    unsigned long computed;
+    unsigned long replayed;
+};
+
+// Stacking changes: one XRestackWindows per change instead of a raise or
+// configure per window
+struct RestackStats {
+    unsigned long restacks;  // XRestackWindows calls
+    unsigned long skipped;   // Passes that found the order unchanged
+    unsigned long requests;  // ConfigureWindow requests those calls sent
+    unsigned long saved;     // Requests restacking every window would have added
+};
+
+// Bar redraw cost
+struct BarStats {
+    unsigned long frames;           // drawBar() calls
+    unsigned long idleFrames;       // Calls that found nothing to redraw
+    unsigned long segmentsDrawn;    // Segments rendered into the back buffer
+    unsigned long segmentsSkipped;  // Segments left as they were
+    unsigned long pixelsCopied;     // Pixels copied to the bar windows
+    double drawTime;                // Total time in drawBar(), ms
+};
+
+// Startup phase timings in milliseconds, logged once initialize() is done
+struct StartupProfile {
+    double atoms;           // Interning wmatom[]/netatom[]
+    double grab;            // Server grabbed for the window scan
+    double scan;            // Window scan including adoption
+    double total;           // All of initialize()
+    unsigned int adopted;   // Windows managed by the scan
+    unsigned int restored;  // Of those, windows whose state a restart carried over
 };
 
 // Client (window) class
@@ -49,14 +175,24 @@ public:
     ~Client();
 
     Window window;
-    std::string name;
+    Title name;
+    bool titleStale;  // Title changed since it was last read
     int x, y, width, height;
     int oldx, oldy, oldwidth, oldheight;
+    int srvx, srvy, srvwidth, srvheight, srvbw;  // Last geometry sent to the server
     int basew, baseh, incw, inch, maxw, maxh, minw, minh;
-    int bw;  // Border width
-    unsigned int tags;
+    int bw, oldbw;  // Border width
+    unsigned int tags;  // Bitmask of tags the client belongs to
     bool isfixed, isfloating, isurgent, neverfocus, oldstate, isfullscreen;
+    unsigned int protocols;  // WM_PROTOCOLS, see protocolBit()
+    long wmstate;     // WM_STATE last written
+    int ignoreUnmap;  // Unmaps we made that the server has yet to report
     Monitor* mon;
+    Client* next;  // Monitor client list
+    Client* prev;
+    FocusLink focus[NUM_TAGS];  // Focus list of each tag the client has
+    unsigned long focusSeq;     // When it was last focused
+    ConfigureFlood flood;
 };
 
 // Layout class
@@ -81,9 +217,10 @@ public:
     void cleanup();
 
     // Window management
-    void manageClient(Window win, XWindowAttributes* wa);
+    void manageClient(const WindowInfo& info);
     void unmanageClient(Client* c, bool destroyed = false);
     void focusClient(Client* c);
+    void focusStack(int dir);
     void unfocusClient(Client* c, bool setfocus = true);
     void killClient(Client* c);
     void toggleFloating(Client* c);
@@ -101,6 +238,7 @@ public:
     void setLayout(LayoutType layout);
     void toggleLayout();
     void arrange(Monitor* m = nullptr);
+    void flushArrange();
     void increaseMasterCount();
     void decreaseMasterCount();
     void increaseMasterSize();
@@ -119,27 +257,45 @@ public:
     // Event handlers
     void handleEvent(XEvent* ev);
 
-private:
-    // X11 related
+    // X11 related (shared with the helpers in window.cpp and layout.cpp)
     Display* display;
     Window root;
     int screen;
     int screenWidth, screenHeight;
     Colormap cmap;
     XftColor colors[2][3];  // [SchemeNorm/SchemeSel][fg/bg/border]
+    XftFont* font;          // Bar font
+    GC gc;
+    int bh;                 // Bar height
+    int lrpad;              // Horizontal padding around bar text
+    std::string statusText;
     Cursor cursors[3];      // Normal, resize, move
-    Atom wmatom[4];         // WM_PROTOCOLS, WM_DELETE_WINDOW, WM_STATE, WM_TAKE_FOCUS
-    Atom netatom[10];       // _NET atoms
+    Atom wmatom[WMLast];    // ICCCM atoms
+    Atom netatom[NetLast];  // EWMH atoms
 
     // Window management
-    std::vector<Monitor> monitors;
+    std::deque<Monitor> monitors;  // Grows and shrinks at the end only
     int currentMonitor;
-    std::unordered_map<Window, std::unique_ptr<Client>> clients;
+    ObjectPool<Client> clientPool;   // Stable storage for every Client
+    WindowTable<Client*> clients;    // Window -> Client index
     Client* focusedClient;
+    bool hideByUnmap;                // How windows on hidden tags are hidden
     std::vector<Layout> layouts;
     bool running;
+    bool restarting;  // Exec a new nwm with the current state once run() returns
 
-    // Event handlers
+    // Event batching
+    std::vector<XEvent> eventBatch;
+    std::unordered_set<unsigned long long> coalesceKeys;
+    EventStats eventStats;
+    ConfigureStats configureStats;
+    LayoutStats layoutStats;
+    RestackStats restackStats;
+    StartupProfile startupProfile;
+    BarStats barStats;
+    void coalesceEvents();
+
+    // Event handlers (referenced from the eventHandlers[] table)
     void handleButtonPress(XEvent* ev);
     void handleClientMessage(XEvent* ev);
     void handleConfigureRequest(XEvent* ev);
@@ -164,11 +320,11 @@ void tileLayout(Monitor* m);
 void monocleLayout(Monitor* m);
 
 // Utility functions
-void spawn(const char** cmd);
+void spawn(const char* const* cmd);
 void quit(void* arg);
 void grabKeys();
 void grabButtons();
 void updateNumlockMask();
 void updateStatus();
-void drawBar(Monitor* m);
-void drawBars();
\ No newline at end of file
+double monotonicMs();
+std::string runtimePath(const char* name);
\ No newline at end of file
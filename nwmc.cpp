@@ -0,0 +1,114 @@
+// nwmc - send commands to nwm over its control socket
+//
+//   nwmc [-s socket] command [args...] [\; command [args...]]...
+//   nwmc [-s socket] < commands
+//
+// With arguments, they are sent as a single command (';' separates several).
+// Without, stdin is sent as one message, one command per line. Either way
+// the commands are applied together or not at all. Exits non-zero if nwm
+// rejected the message.
+
+#include "config.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Same rules as nwm's runtimePath()
+static std::string socketPath() {
+    const char* env = getenv("NWM_SOCKET");
+    if (env && *env) return env;
+
+    const char* dir = getenv("XDG_RUNTIME_DIR");
+    const char* dpy = getenv("DISPLAY");
+    std::string path = (dir && *dir) ? dir : "/tmp";
+
+    path += "/";
+    path += IPC_SOCKET;
+    if (dpy && *dpy) {
+        path += "-";
+        for (const char* p = dpy; *p; p++) {
+            path += (*p == '/') ? '_' : *p;
+        }
+    }
+    return path;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: nwmc [-s socket] [command [args...]]\n");
+    exit(2);
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = socketPath();
+    std::string msg;
+    int i = 1;
+
+    if (i < argc && !strcmp(argv[i], "-s")) {
+        if (i + 1 >= argc) usage();
+        path = argv[i + 1];
+        i += 2;
+    }
+    if (i < argc && argv[i][0] == '-') usage();
+
+    if (i < argc) {
+        for (; i < argc; i++) {
+            msg += argv[i];
+            msg += ' ';
+        }
+    } else {
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0) {
+            msg.append(buf, n);
+        }
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "nwmc: socket path too long: %s\n", path.c_str());
+        return 1;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        fprintf(stderr, "nwmc: cannot connect to %s: %s\n", path.c_str(), strerror(errno));
+        return 1;
+    }
+
+    // The message ends when we stop writing
+    for (size_t off = 0; off < msg.size();) {
+        ssize_t n = write(fd, msg.data() + off, msg.size() - off);
+        if (n < 0) {
+            fprintf(stderr, "nwmc: write failed: %s\n", strerror(errno));
+            return 1;
+        }
+        off += n;
+    }
+    shutdown(fd, SHUT_WR);
+
+    std::string reply;
+    char buf[256];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        reply.append(buf, n);
+    }
+    close(fd);
+
+    if (reply.empty()) {
+        fprintf(stderr, "nwmc: no reply\n");
+        return 1;
+    }
+    if (reply.compare(0, 3, "ok ")) {
+        fputs(reply.c_str(), stderr);
+        return 1;
+    }
+    return 0;
+}
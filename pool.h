@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Slab allocator for objects that need stable addresses.
+// Objects are constructed in place inside fixed-size slabs that are only
+// released with the pool; freed slots are kept on an intrusive free list
+// and reused before a new slab is allocated.
+template <typename T, size_t SlabSize = 64>
+class ObjectPool {
+public:
+    ObjectPool() : freeList(nullptr), live(0) {}
+
+    ~ObjectPool() {
+        for (auto& slab : slabs) {
+            for (size_t i = 0; i < SlabSize; i++) {
+                if (slab[i].live) {
+                    slab[i].object()->~T();
+                }
+            }
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // Construct a new object, reusing a freed slot if there is one
+    template <typename... Args>
+    T* create(Args&&... args) {
+        if (!freeList) {
+            grow();
+        }
+
+        Slot* s = freeList;
+        T* obj = new (s->storage) T(std::forward<Args>(args)...);
+        freeList = s->next;
+        s->live = true;
+        live++;
+        return obj;
+    }
+
+    // Destroy an object and return its slot to the free list
+    void destroy(T* obj) {
+        if (!obj) return;
+
+        Slot* s = reinterpret_cast<Slot*>(obj);
+        obj->~T();
+        s->live = false;
+        s->next = freeList;
+        freeList = s;
+        live--;
+    }
+
+    size_t size() const { return live; }
+    size_t capacity() const { return slabs.size() * SlabSize; }
+
+private:
+    struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+        Slot* next;
+        bool live;
+
+        T* object() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    void grow() {
+        slabs.emplace_back(new Slot[SlabSize]);
+        Slot* slab = slabs.back().get();
+        for (size_t i = SlabSize; i-- > 0;) {
+            slab[i].live = false;
+            slab[i].next = freeList;
+            freeList = &slab[i];
+        }
+    }
+
+    std::vector<std::unique_ptr<Slot[]>> slabs;
+    Slot* freeList;
+    size_t live;
+};
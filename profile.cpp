@@ -0,0 +1,96 @@
+#include "profile.h"
+#include <cstdio>
+#include <ctime>
+#include <signal.h>
+
+ServerCounters serverCounters;
+
+static HandlerProfile profiles[ProfileLast];
+static volatile sig_atomic_t dumpRequested;
+
+static const char* slotNames[ProfileLast] = {
+    nullptr, nullptr,
+    "KeyPress", "KeyRelease", "ButtonPress", "ButtonRelease", "MotionNotify",
+    "EnterNotify", "LeaveNotify", "FocusIn", "FocusOut", "KeymapNotify",
+    "Expose", "GraphicsExpose", "NoExpose", "VisibilityNotify", "CreateNotify",
+    "DestroyNotify", "UnmapNotify", "MapNotify", "MapRequest", "ReparentNotify",
+    "ConfigureNotify", "ConfigureRequest", "GravityNotify", "ResizeRequest",
+    "CirculateNotify", "CirculateRequest", "PropertyNotify", "SelectionClear",
+    "SelectionRequest", "SelectionNotify", "ColormapNotify", "ClientMessage",
+    "MappingNotify", "GenericEvent",
+    "arrange", "bar", "ipc"
+};
+static_assert(LASTEvent == 36, "slotNames[] lists the core X event types");
+
+static uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + ts.tv_nsec;
+}
+
+ProfileMark profileBegin() {
+    return ProfileMark{ nowNs(), NextRequest(g_windowManager->display),
+                        serverCounters.roundTrips, serverCounters.grabs };
+}
+
+void profileEnd(int slot, const ProfileMark& mark) {
+    HandlerProfile& p = profiles[slot];
+    uint64_t ns = nowNs() - mark.ns;
+    uint64_t us = ns / 1000;
+
+    p.calls++;
+    p.totalNs += ns;
+    p.maxNs = MAX(p.maxNs, ns);
+    p.requests += NextRequest(g_windowManager->display) - mark.requests;
+    p.roundTrips += serverCounters.roundTrips - mark.roundTrips;
+    p.grabs += serverCounters.grabs - mark.grabs;
+
+    // Bit length of the microsecond count picks the power of two bucket
+    int b = us ? 64 - __builtin_clzll(us) : 0;
+    p.buckets[MIN(b, PROFILE_BUCKETS - 1)]++;
+}
+
+const HandlerProfile& handlerProfile(int slot) {
+    return profiles[slot];
+}
+
+void profileDump(std::string& out) {
+    char line[256];
+
+    for (int s = 0; s < ProfileLast; s++) {
+        const HandlerProfile& p = profiles[s];
+        if (!p.calls) continue;
+
+        snprintf(line, sizeof(line),
+                 "profile handler=%s calls=%lu us_total=%lu us_max=%lu requests=%lu "
+                 "round_trips=%lu grabs=%lu hist=",
+                 slotNames[s], p.calls, static_cast<unsigned long>(p.totalNs / 1000),
+                 static_cast<unsigned long>(p.maxNs / 1000), p.requests, p.roundTrips, p.grabs);
+        out += line;
+        for (int b = 0; b < PROFILE_BUCKETS; b++) {
+            snprintf(line, sizeof(line), b ? ",%lu" : "%lu", p.buckets[b]);
+            out += line;
+        }
+        out += '\n';
+    }
+
+    snprintf(line, sizeof(line), "profile total requests=%lu round_trips=%lu grabs=%lu\n",
+             NextRequest(g_windowManager->display) - 1, serverCounters.roundTrips,
+             serverCounters.grabs);
+    out += line;
+}
+
+void installProfileSignal() {
+    struct sigaction sa = {};
+
+    // No SA_RESTART, so the signal also wakes run() out of poll()
+    sa.sa_handler = [](int) { dumpRequested = 1; };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, nullptr);
+}
+
+bool profileDumpRequested() {
+    if (!dumpRequested) return false;
+    dumpRequested = 0;
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "nwm.h"
+#include <cstdint>
+#include <string>
+
+// Per-handler profiling, cheap enough to leave on: two clock reads and a
+// few counter snapshots per dispatched event.
+
+// Latency histogram: bucket 0 counts calls under 1 us, bucket i calls
+// under 2^i us, and the last bucket everything slower
+constexpr int PROFILE_BUCKETS = 16;
+
+// Work done outside the event handlers, profiled alongside them after the
+// X event types
+enum ProfileSlot { ProfileArrange = LASTEvent, ProfileBar, ProfileIpc, ProfileLast };
+
+struct HandlerProfile {
+    unsigned long calls;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    unsigned long requests;    // X requests issued
+    unsigned long roundTrips;  // Waits for a reply from the server
+    unsigned long grabs;       // Server grabs
+    unsigned long buckets[PROFILE_BUCKETS];
+};
+
+// Xlib cannot tell us when it blocks, so the call sites that wait for a
+// reply or grab the server count themselves
+struct ServerCounters {
+    unsigned long roundTrips;
+    unsigned long grabs;
+};
+extern ServerCounters serverCounters;
+
+inline void countRoundTrips(unsigned long n = 1) { serverCounters.roundTrips += n; }
+inline void countGrab() { serverCounters.grabs++; }
+
+// Counters at the start of a profiled call
+struct ProfileMark {
+    uint64_t ns;
+    unsigned long requests;
+    unsigned long roundTrips;
+    unsigned long grabs;
+};
+
+ProfileMark profileBegin();
+void profileEnd(int slot, const ProfileMark& mark);
+
+const HandlerProfile& handlerProfile(int slot);
+
+// Append one line per slot that has run, then a line of totals:
+//   profile handler=<name> calls= us_total= us_max= requests= round_trips= grabs= hist=<b0,b1,...>
+//   profile total requests= round_trips= grabs=
+void profileDump(std::string& out);
+
+// SIGUSR1 asks for a dump on stderr; run() checks for it after each wakeup
+void installProfileSignal();
+bool profileDumpRequested();
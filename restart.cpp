@@ -0,0 +1,243 @@
+#include "restart.h"
+#include "layout.h"
+#include "profile.h"
+#include "window.h"
+#include <X11/Xatom.h>
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+
+// Layout of _NWM_STATE, all 32-bit words:
+//   header   magic, monitors, clients, focused window
+//   monitor  tagset, selectedTag, previousTag, showbar,
+//            then per tag: layout, previousLayout, mfact * 10000, nmaster
+//   client   window, monitor, tags, floating, x, y, width, height, focus rank
+// Clients are in client list order, front first.
+static constexpr long STATE_MAGIC = 0x4e574d31;  // "NWM1"
+static constexpr size_t HEADER_WORDS = 4;
+static constexpr size_t MONITOR_WORDS = 4 + 4 * NUM_TAGS;
+static constexpr size_t CLIENT_WORDS = 9;
+
+struct SavedClient {
+    int monitor;
+    unsigned int tags;
+    bool isfloating;
+    int x, y, width, height;
+    unsigned long rank;  // Focus order, larger is more recent
+    size_t order;        // Position in the client list
+};
+
+static std::unordered_map<Window, SavedClient> saved;
+static Window savedFocus;
+
+static bool inRange(long v, long lo, long hi) {
+    return v >= lo && v <= hi;
+}
+
+// Any client can write the property, so every field is checked before
+// any of it is used. w starts past the header.
+static bool validState(const long* w, size_t nmon, size_t ncli) {
+    const long tagMask = (1L << NUM_TAGS) - 1;
+    const long lastLayout = static_cast<long>(LayoutType::MONOCLE);
+
+    for (size_t i = 0; i < nmon; i++, w += MONITOR_WORDS) {
+        if (!inRange(w[0], 1, tagMask) || !inRange(w[1], 0, NUM_TAGS - 1) ||
+            !inRange(w[2], 0, NUM_TAGS - 1) || !inRange(w[3], 0, 1)) {
+            return false;
+        }
+        for (int t = 0; t < NUM_TAGS; t++) {
+            const long* tw = w + 4 + 4 * t;
+            if (!inRange(tw[0], 0, lastLayout) || !inRange(tw[1], 0, lastLayout) ||
+                !inRange(tw[2], 500, 9500) || !inRange(tw[3], 0, INT_MAX)) {
+                return false;
+            }
+        }
+    }
+    for (size_t i = 0; i < ncli; i++, w += CLIENT_WORDS) {
+        if (!inRange(w[1], 0, static_cast<long>(nmon) - 1) || !inRange(w[2], 0, tagMask) ||
+            !inRange(w[3], 0, 1) || !inRange(w[4], SHRT_MIN, SHRT_MAX) ||
+            !inRange(w[5], SHRT_MIN, SHRT_MAX) || !inRange(w[6], 1, USHRT_MAX) ||
+            !inRange(w[7], 1, USHRT_MAX) || w[8] < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void restart(void*) {
+    g_windowManager->restarting = true;
+    g_windowManager->running = false;
+}
+
+void saveState() {
+    WindowManager* wm = g_windowManager;
+    std::vector<long> words;
+    size_t nclients = 0;
+
+    for (Monitor& m : wm->monitors) {
+        for (Client* c = m.clients; c; c = c->next) {
+            nclients++;
+        }
+    }
+    words.reserve(HEADER_WORDS + wm->monitors.size() * MONITOR_WORDS + nclients * CLIENT_WORDS);
+
+    Client* sel = wm->getFocusedClient();
+    words.push_back(STATE_MAGIC);
+    words.push_back(wm->monitors.size());
+    words.push_back(nclients);
+    words.push_back(sel ? sel->window : None);
+
+    for (Monitor& m : wm->monitors) {
+        words.push_back(m.tagset);
+        words.push_back(m.selectedTag);
+        words.push_back(m.previousTag);
+        words.push_back(m.showbar);
+        for (const Tag& t : m.tags) {
+            words.push_back(static_cast<long>(t.layout));
+            words.push_back(static_cast<long>(t.previousLayout));
+            words.push_back(static_cast<long>(t.mfact * 10000 + 0.5f));
+            words.push_back(t.nmaster);
+        }
+    }
+
+    for (Monitor& m : wm->monitors) {
+        for (Client* c = m.clients; c; c = c->next) {
+            words.push_back(c->window);
+            words.push_back(m.num);
+            words.push_back(c->tags);
+            words.push_back(c->isfloating);
+            words.push_back(c->x);
+            words.push_back(c->y);
+            words.push_back(c->width);
+            words.push_back(c->height);
+            words.push_back(static_cast<long>(c->focusSeq));
+        }
+    }
+
+    XChangeProperty(wm->display, wm->root, wm->wmatom[WMRestartState], XA_CARDINAL, 32,
+                    PropModeReplace, reinterpret_cast<unsigned char*>(words.data()), words.size());
+}
+
+bool loadState() {
+    WindowManager* wm = g_windowManager;
+    Atom type;
+    int format;
+    unsigned long nitems, after;
+    unsigned char* data = nullptr;
+
+    // Read and delete in one request
+    countRoundTrips();
+    if (XGetWindowProperty(wm->display, wm->root, wm->wmatom[WMRestartState], 0L, 0x100000L,
+                           True, XA_CARDINAL, &type, &format, &nitems, &after,
+                           &data) != Success || !data) {
+        return false;
+    }
+
+    const long* w = reinterpret_cast<const long*>(data);
+    size_t nmon = nitems >= HEADER_WORDS ? w[1] : 0;
+    size_t ncli = nitems >= HEADER_WORDS ? w[2] : 0;
+    if (format != 32 || nitems < HEADER_WORDS || w[0] != STATE_MAGIC ||
+        nmon > nitems || ncli > nitems ||
+        nitems != HEADER_WORDS + nmon * MONITOR_WORDS + ncli * CLIENT_WORDS ||
+        !validState(w + HEADER_WORDS, nmon, ncli)) {
+        fprintf(stderr, "nwm: ignoring malformed saved state\n");
+        XFree(data);
+        return false;
+    }
+
+    savedFocus = w[3];
+    w += HEADER_WORDS;
+    for (size_t i = 0; i < nmon; i++, w += MONITOR_WORDS) {
+        if (i >= wm->monitors.size()) continue;
+
+        // A monitor that got a different head keeps its tags anyway
+        Monitor& m = wm->monitors[i];
+        m.tagset = w[0];
+        m.selectedTag = w[1];
+        m.previousTag = w[2];
+        if (m.showbar != (w[3] != 0)) {
+            m.showbar = w[3] != 0;
+            updateBarPos(&m);
+        }
+        for (int t = 0; t < NUM_TAGS; t++) {
+            const long* tw = w + 4 + 4 * t;
+            m.tags[t].layout = static_cast<LayoutType>(tw[0]);
+            m.tags[t].previousLayout = static_cast<LayoutType>(tw[1]);
+            m.tags[t].mfact = tw[2] / 10000.0f;
+            m.tags[t].nmaster = tw[3];
+        }
+    }
+
+    saved.clear();
+    saved.reserve(ncli);
+    for (size_t i = 0; i < ncli; i++, w += CLIENT_WORDS) {
+        SavedClient s;
+        // Clients of a monitor that went away land on the first one
+        s.monitor = w[1] < static_cast<long>(wm->monitors.size()) ? w[1] : 0;
+        s.tags = w[2];
+        s.isfloating = w[3] != 0;
+        s.x = w[4];
+        s.y = w[5];
+        s.width = w[6];
+        s.height = w[7];
+        s.rank = static_cast<unsigned long>(w[8]);
+        s.order = i;
+        saved[w[0]] = s;
+    }
+    XFree(data);
+    return true;
+}
+
+bool restoreClient(Client* c) {
+    auto it = saved.find(c->window);
+    if (it == saved.end()) return false;
+
+    const SavedClient& s = it->second;
+    c->mon = &g_windowManager->monitors[s.monitor];
+    c->tags = s.tags ? s.tags : c->mon->tagset;
+    c->isfloating = s.isfloating;
+    c->x = c->oldx = s.x;
+    c->y = c->oldy = s.y;
+    c->width = c->oldwidth = s.width;
+    c->height = c->oldheight = s.height;
+    return true;
+}
+
+void finishRestore() {
+    WindowManager* wm = g_windowManager;
+    std::vector<Client*> restored;
+
+    for (Monitor& m : wm->monitors) {
+        for (Client* c = m.clients; c; c = c->next) {
+            if (saved.count(c->window)) {
+                restored.push_back(c);
+            }
+        }
+    }
+
+    // Client lists: attaching pushes to the front, so go back to front.
+    // Windows that were not saved stay ahead of the restored ones.
+    std::sort(restored.begin(), restored.end(), [](Client* a, Client* b) {
+        return saved[a->window].order > saved[b->window].order;
+    });
+    for (Client* c : restored) {
+        detachClient(c);
+        attachClient(c);
+    }
+
+    // Focus lists: promote oldest first, then focus the one that had it
+    std::sort(restored.begin(), restored.end(), [](Client* a, Client* b) {
+        return saved[a->window].rank < saved[b->window].rank;
+    });
+    for (Client* c : restored) {
+        if (saved[c->window].rank) {
+            promoteStack(c);
+        }
+    }
+
+    Client* sel = wm->getClientByWindow(savedFocus);
+    wm->focusClient(sel && ISVISIBLE(sel) ? sel : nullptr);
+
+    saved.clear();
+    savedFocus = None;
+}
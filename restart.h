@@ -0,0 +1,31 @@
+#pragma once
+
+#include "nwm.h"
+
+// In-place restart.
+//
+// Before nwm execs itself, saveState() writes the monitors' tags and
+// layout settings and every client's monitor, tags, floating geometry and
+// focus order to the _NWM_STATE root property, as 32-bit words. The new
+// process reads and deletes it with loadState() right after finding its
+// monitors, applies it to each window as it is adopted with
+// restoreClient(), then puts client and focus order back with
+// finishRestore(). Windows stay mapped or parked where they were, so
+// their clients see no map, unmap or focus churn.
+
+// Request a restart once the current batch is done
+void restart(void* arg);
+
+void saveState();
+
+// Read and consume a saved state, applying the monitor part. Returns false
+// if there was none (a normal start).
+bool loadState();
+
+// Apply the saved state of c's window, if any; call before c is mapped
+// and attached. Returns false if the window was not saved.
+bool restoreClient(Client* c);
+
+// Restore client list and focus order once every window is adopted, and
+// drop the saved state
+void finishRestore();
@@ -0,0 +1,76 @@
+#include "rules.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Rules filed under the exact strings they match: "c<class>",
+// "i<instance>" or, for rules naming both, "p<class>\0<instance>". Rules
+// naming neither can only be told apart by title and are tried for every
+// window.
+static const Rule* table;
+static std::unordered_map<std::string, std::vector<unsigned int>> byKey;
+static std::vector<unsigned int> anyRules;
+static std::vector<unsigned int> candidates;  // Reused by matchRules()
+static std::string probe;
+
+static const std::string& ruleKey(char kind, const char* a, size_t alen, const char* b, size_t blen) {
+    probe.assign(1, kind);
+    probe.append(a, alen);
+    if (b) {
+        probe += '\0';
+        probe.append(b, blen);
+    }
+    return probe;
+}
+
+void compileRules(const Rule* rules, size_t n) {
+    table = rules;
+    byKey.clear();
+    anyRules.clear();
+
+    for (size_t i = 0; i < n; i++) {
+        const Rule& r = rules[i];
+        if (r.cls && r.instance) {
+            byKey[ruleKey('p', r.cls, strlen(r.cls), r.instance, strlen(r.instance))].push_back(i);
+        } else if (r.cls) {
+            byKey[ruleKey('c', r.cls, strlen(r.cls), nullptr, 0)].push_back(i);
+        } else if (r.instance) {
+            byKey[ruleKey('i', r.instance, strlen(r.instance), nullptr, 0)].push_back(i);
+        } else {
+            anyRules.push_back(i);
+        }
+    }
+}
+
+static void collect(const std::string& key) {
+    auto it = byKey.find(key);
+    if (it != byKey.end()) {
+        candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+    }
+}
+
+RuleMatch matchRules(const std::string& cls, const std::string& instance, const std::string& title) {
+    RuleMatch m = { 0, 0, false, -1 };
+
+    candidates.clear();
+    collect(ruleKey('p', cls.data(), cls.size(), instance.data(), instance.size()));
+    collect(ruleKey('c', cls.data(), cls.size(), nullptr, 0));
+    collect(ruleKey('i', instance.data(), instance.size(), nullptr, 0));
+    candidates.insert(candidates.end(), anyRules.begin(), anyRules.end());
+
+    // Each rule sits in one list only, so sorting restores table order
+    std::sort(candidates.begin(), candidates.end());
+    for (unsigned int i : candidates) {
+        const Rule& r = table[i];
+        if (r.title && !strstr(title.c_str(), r.title)) continue;
+
+        m.matched++;
+        m.tags |= r.tags;
+        m.isfloating = r.isfloating;
+        if (r.monitor >= 0) {
+            m.monitor = r.monitor;
+        }
+    }
+    return m;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "config.h"
+#include <cstddef>
+#include <string>
+
+// What the rules matching a window ask for
+struct RuleMatch {
+    unsigned int matched;  // Number of rules that matched
+    unsigned int tags;     // Union of their tags
+    bool isfloating;       // From the last one
+    int monitor;           // From the last one that names a monitor, else -1
+};
+
+// Index a rules table for matchRules(). Called once at startup with RULES;
+// the table must outlive the index.
+void compileRules(const Rule* rules, size_t n);
+
+// Apply every rule matching a window's WM_CLASS and title, in table order.
+// Costs a few hash lookups however many rules there are, plus a substring
+// search for each rule matched by class or instance that also names a
+// title, and for each rule that names neither.
+RuleMatch matchRules(const std::string& cls, const std::string& instance, const std::string& title);
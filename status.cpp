@@ -0,0 +1,97 @@
+#include "status.h"
+#include "nwm.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int fifoFd = -1;
+static std::string partial;  // Bytes after the last newline seen
+static bool discarding;      // Dropping the rest of an overlong line
+
+// Create the FIFO if needed and open it. It is opened read-write so that
+// there is always a writer and poll() never reports a hangup between two
+// status daemon runs (Linux semantics).
+bool openStatusFifo() {
+    std::string path = runtimePath(STATUS_FIFO);
+
+    if (mkfifo(path.c_str(), 0600) < 0 && errno != EEXIST) {
+        fprintf(stderr, "nwm: cannot create status fifo %s: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    fifoFd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC | O_NOFOLLOW);
+    if (fifoFd < 0) {
+        fprintf(stderr, "nwm: cannot open status fifo %s: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    // The path may be in a shared /tmp, where someone else could have
+    // put anything there first
+    struct stat st;
+    if (fstat(fifoFd, &st) < 0 || !S_ISFIFO(st.st_mode) || st.st_uid != getuid()) {
+        fprintf(stderr, "nwm: %s is not a fifo of ours\n", path.c_str());
+        closeStatusFifo();
+        return false;
+    }
+    return true;
+}
+
+void closeStatusFifo() {
+    if (fifoFd >= 0) {
+        close(fifoFd);
+        fifoFd = -1;
+    }
+}
+
+int statusFifoFd() {
+    return fifoFd;
+}
+
+// Drain the FIFO and keep only the newest complete line. A burst of
+// updates therefore costs one status change and at most one redraw of the
+// status segment per event batch; an unchanged line costs nothing.
+void readStatusFifo() {
+    WindowManager* wm = g_windowManager;
+    char buf[4096];
+    ssize_t n;
+    std::string latest;
+    bool complete = false;
+
+    if (fifoFd < 0) return;
+
+    while ((n = read(fifoFd, buf, sizeof(buf))) > 0) {
+        const char* p = buf;
+        if (discarding) {
+            const char* nl = static_cast<const char*>(memchr(buf, '\n', n));
+            if (!nl) continue;
+            discarding = false;
+            n -= nl + 1 - buf;
+            p = nl + 1;
+        }
+        partial.append(p, n);
+
+        // Refuse to buffer without bound if a writer never sends a newline;
+        // the rest of the line is dropped too, not taken for a whole one
+        size_t end = partial.rfind('\n');
+        if (end == std::string::npos) {
+            if (partial.size() > sizeof(buf)) {
+                partial.clear();
+                discarding = true;
+            }
+            continue;
+        }
+
+        size_t begin = partial.rfind('\n', end ? end - 1 : 0);
+        begin = (begin == std::string::npos || begin >= end) ? 0 : begin + 1;
+        latest.assign(partial, begin, end - begin);
+        partial.erase(0, end + 1);
+        complete = true;
+    }
+
+    if (complete && latest != wm->statusText) {
+        wm->statusText.swap(latest);
+    }
+}
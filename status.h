@@ -0,0 +1,11 @@
+#pragma once
+
+#include "nwm.h"
+
+// Status text input over a FIFO. A status daemon writes one line per
+// update; nwm reads whatever is available without blocking and keeps the
+// last complete line.
+bool openStatusFifo();
+void closeStatusFifo();
+int statusFifoFd();
+void readStatusFifo();
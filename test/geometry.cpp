@@ -0,0 +1,66 @@
+// Golden-output tests for the pure layout geometry. Each case runs a
+// layout over a fixed area and compares every rect with the expected one.
+// No X server.
+
+#include "../geometry.h"
+#include <cstdio>
+#include <vector>
+
+struct Case {
+    const char* name;
+    LayoutGeometry geometry;
+    LayoutArea area;
+    int bw;
+    std::vector<Rect> want;  // One per client
+};
+
+static const Case CASES[] = {
+    { "tile n=0", tileGeometry, { 0, 0, 1000, 700, 0.55f, 1 }, 1, {} },
+    { "tile n=1", tileGeometry, { 0, 0, 1000, 700, 0.55f, 1 }, 1,
+      { { 0, 0, 998, 698 } } },
+    { "tile nmaster=0", tileGeometry, { 0, 0, 1000, 700, 0.55f, 0 }, 1,
+      { { 0, 0, 998, 231 }, { 0, 233, 998, 231 }, { 0, 466, 998, 232 } } },
+    { "tile nmaster>n", tileGeometry, { 0, 0, 1000, 700, 0.55f, 5 }, 1,
+      { { 0, 0, 998, 348 }, { 0, 350, 998, 348 } } },
+    // 701 / 3 leaves a remainder of 2, which goes to the last two
+    { "tile odd height", tileGeometry, { 10, 20, 1001, 701, 0.55f, 1 }, 1,
+      { { 10, 20, 548, 699 }, { 560, 20, 449, 231 }, { 560, 253, 449, 232 },
+        { 560, 487, 449, 232 } } },
+    { "tile bw=3", tileGeometry, { 0, 0, 800, 601, 0.5f, 2 }, 3,
+      { { 0, 0, 394, 294 }, { 0, 300, 394, 295 }, { 400, 0, 394, 595 } } },
+    { "monocle n=0", monocleGeometry, { 0, 0, 1000, 700, 0.55f, 1 }, 1, {} },
+    { "monocle n=1 bw=0", monocleGeometry, { 0, 0, 100, 50, 0.55f, 1 }, 0,
+      { { 0, 0, 100, 50 } } },
+    { "monocle odd height bw=2", monocleGeometry, { 5, 15, 640, 481, 0.55f, 1 }, 2,
+      { { 5, 15, 636, 477 }, { 5, 15, 636, 477 } } },
+};
+
+static bool sameRect(const Rect& a, const Rect& b) {
+    return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+int main() {
+    const Rect sentinel = { -1, -1, -1, -1 };
+    int failed = 0;
+
+    for (const Case& t : CASES) {
+        size_t n = t.want.size();
+        std::vector<LayoutItem> items(n, LayoutItem{ t.bw });
+        // One spare rect to catch writes past the end
+        std::vector<Rect> got(n + 1, sentinel);
+
+        t.geometry(t.area, items.data(), n, got.data());
+        for (size_t i = 0; i <= n; i++) {
+            const Rect& want = i < n ? t.want[i] : sentinel;
+            if (!sameRect(got[i], want)) {
+                printf("FAIL %s: rect %zu is %d,%d %dx%d, want %d,%d %dx%d\n", t.name, i,
+                       got[i].x, got[i].y, got[i].w, got[i].h, want.x, want.y, want.w, want.h);
+                failed++;
+            }
+        }
+    }
+
+    size_t ncases = sizeof(CASES) / sizeof(CASES[0]);
+    printf("test     geometry cases=%zu failed=%d\n", ncases, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+#include "textcache.h"
+#include "nwm.h"
+#include <fontconfig/fontconfig.h>
+#include <list>
+#include <string_view>
+#include <unordered_map>
+
+static const char ELLIPSIS[] = "...";
+
+// One cached string; the list owns the text the index keys point into
+struct CacheEntry {
+    XftFont* font;
+    std::string text;
+    TextRun run;
+};
+
+struct CacheKey {
+    XftFont* font;
+    std::string_view text;
+
+    bool operator==(const CacheKey& o) const { return font == o.font && text == o.text; }
+};
+
+struct CacheKeyHash {
+    size_t operator()(const CacheKey& k) const {
+        return std::hash<std::string_view>()(k.text) ^ (reinterpret_cast<size_t>(k.font) >> 4);
+    }
+};
+
+// Most recently used at the front
+static std::list<CacheEntry> lru;
+static std::unordered_map<CacheKey, std::list<CacheEntry>::iterator, CacheKeyHash> cacheIndex;
+static TextCacheStats stats;
+
+// Convert UTF-8 to glyphs and measure each one. This is the only place
+// the bar asks Xft about text.
+static void shape(XftFont* font, const std::string& text, TextRun& run) {
+    Display* dpy = g_windowManager->display;
+    const FcChar8* p = reinterpret_cast<const FcChar8*>(text.data());
+    int left = text.size();
+
+    run.glyphs.clear();
+    run.advance.assign(1, 0);
+    while (left > 0) {
+        FcChar32 ucs4;
+        int len = FcUtf8ToUcs4(p, &ucs4, left);
+        if (len <= 0) break;
+        p += len;
+        left -= len;
+
+        FT_UInt glyph = XftCharIndex(dpy, font, ucs4);
+        XGlyphInfo ext;
+        XftGlyphExtents(dpy, font, &glyph, 1, &ext);
+        run.glyphs.push_back(glyph);
+        run.advance.push_back(run.advance.back() + ext.xOff);
+    }
+    run.width = run.advance.back();
+    run.fitWidth = -1;
+    run.fitGlyphs = run.glyphs.size();
+}
+
+TextRun& shapeText(XftFont* font, const std::string& text) {
+    auto it = cacheIndex.find(CacheKey{font, text});
+    if (it != cacheIndex.end()) {
+        stats.hits++;
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->run;
+    }
+
+    stats.misses++;
+    if (lru.size() >= TEXT_CACHE_SIZE) {
+        CacheEntry& old = lru.back();
+        cacheIndex.erase(CacheKey{old.font, old.text});
+        lru.pop_back();
+        stats.evictions++;
+    }
+
+    lru.emplace_front();
+    CacheEntry& e = lru.front();
+    e.font = font;
+    e.text = text;
+    shape(font, e.text, e.run);
+    cacheIndex.emplace(CacheKey{font, e.text}, lru.begin());
+    return e.run;
+}
+
+size_t fitText(TextRun& run, int w, int ellipsisWidth) {
+    if (run.width <= w) {
+        return run.glyphs.size();
+    }
+    if (run.fitWidth == w) {
+        return run.fitGlyphs;
+    }
+
+    // Largest prefix that leaves room for the ellipsis
+    size_t lo = 0, hi = run.glyphs.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi + 1) / 2;
+        if (run.advance[mid] + ellipsisWidth <= w) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    run.fitWidth = w;
+    run.fitGlyphs = lo;
+    return lo;
+}
+
+void drawTextRun(XftDraw* draw, const XftColor* color, XftFont* font,
+                 int x, int y, int w, const std::string& text) {
+    // Both lookups move their entry to the front of the list, so the
+    // second cannot evict the first
+    TextRun& run = shapeText(font, text);
+    const TextRun& dots = shapeText(font, ELLIPSIS);
+
+    size_t n = fitText(run, w, dots.width);
+    if (n) {
+        XftDrawGlyphs(draw, color, font, x, y, run.glyphs.data(), n);
+    }
+    if (n < run.glyphs.size() && dots.width <= w) {
+        XftDrawGlyphs(draw, color, font, x + run.advance[n], y,
+                      dots.glyphs.data(), dots.glyphs.size());
+    }
+}
+
+const TextCacheStats& textCacheStats() {
+    return stats;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <X11/Xft/Xft.h>
+#include <string>
+#include <vector>
+
+// Number of shaped strings kept before the least recently used is dropped
+constexpr size_t TEXT_CACHE_SIZE = 256;
+
+// A string converted to glyphs and measured once
+struct TextRun {
+    std::vector<FT_UInt> glyphs;  // Glyph indices in the font
+    std::vector<int> advance;     // advance[i]: width of the first i glyphs
+    int width;                    // Width of the whole run
+    int fitWidth;                 // Last width fit() was asked about
+    size_t fitGlyphs;             // Glyphs that fit fitWidth with an ellipsis
+};
+
+// Text cache effectiveness
+struct TextCacheStats {
+    unsigned long hits;
+    unsigned long misses;     // Strings shaped with Xft
+    unsigned long evictions;
+};
+
+// Look up (or shape and insert) text in font. The reference stays valid
+// until TEXT_CACHE_SIZE other strings have been looked up.
+TextRun& shapeText(XftFont* font, const std::string& text);
+
+// Number of leading glyphs of run that fit in w pixels when followed by
+// an ellipsis, or run.glyphs.size() if the whole run fits without one
+size_t fitText(TextRun& run, int w, int ellipsisWidth);
+
+// Draw text shaped by shapeText(), truncated with an ellipsis to w pixels
+void drawTextRun(XftDraw* draw, const XftColor* color, XftFont* font,
+                 int x, int y, int w, const std::string& text);
+
+const TextCacheStats& textCacheStats();
@@ -0,0 +1,50 @@
+#include "title.h"
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+// Keys point into the entries' own text
+static std::unordered_map<std::string_view, TitleEntry*> titles;
+static TitleStats stats;
+
+void setTitle(Title& t, const char* text, size_t len) {
+    if (t && t->text.size() == len && !memcmp(t->text.data(), text, len)) {
+        stats.unchanged++;
+        return;
+    }
+
+    std::string_view key(text, len);
+    auto it = titles.find(key);
+    TitleEntry* e;
+    if (it != titles.end()) {
+        e = it->second;
+    } else {
+        e = new TitleEntry{ std::string(key), 0 };
+        titles.emplace(e->text, e);
+        stats.entries++;
+    }
+    e->refs++;
+    releaseTitle(t);
+    t = e;
+}
+
+void releaseTitle(Title& t) {
+    if (!t) return;
+
+    TitleEntry* e = const_cast<TitleEntry*>(t);
+    t = nullptr;
+    if (--e->refs == 0) {
+        titles.erase(e->text);
+        delete e;
+        stats.entries--;
+    }
+}
+
+const std::string& titleText(Title t) {
+    static const std::string empty;
+    return t ? t->text : empty;
+}
+
+TitleStats& titleStats() {
+    return stats;
+}
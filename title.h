@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Interned window titles. Clients showing the same text share one
+// reference-counted entry, a title set to what it already was costs a
+// comparison and no allocation, and the entry is freed with its last user.
+struct TitleEntry {
+    std::string text;
+    unsigned int refs;
+};
+typedef const TitleEntry* Title;  // nullptr when unset
+
+// Title churn
+struct TitleStats {
+    unsigned long changes;    // WM_NAME/_NET_WM_NAME notifications
+    unsigned long reads;      // Titles fetched from the server
+    unsigned long unchanged;  // Fetches that found the title as it was
+    unsigned long entries;    // Distinct titles held
+};
+
+// Point t at text, releasing what it held
+void setTitle(Title& t, const char* text, size_t len);
+void releaseTitle(Title& t);
+
+// Text of a title, empty if unset
+const std::string& titleText(Title t);
+
+TitleStats& titleStats();
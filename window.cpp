@@ -1,22 +1,31 @@
 #include "window.h"
 #include "nwm.h"
+#include "xquery.h"
+#include "profile.h"
+#include "rules.h"
+#include "title.h"
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
 #include <X11/Xutil.h>
+#include <cmath>
 #include <cstring>
 
 // Client constructor
 Client::Client(Window win) 
-    : window(win), x(0), y(0), width(0), height(0),
+    : window(win), name(nullptr), titleStale(false), x(0), y(0), width(0), height(0),
       oldx(0), oldy(0), oldwidth(0), oldheight(0),
+      srvx(0), srvy(0), srvwidth(0), srvheight(0), srvbw(0),
       basew(0), baseh(0), incw(0), inch(0), maxw(0), maxh(0), minw(0), minh(0),
       bw(BORDER_PX), tags(0),
       isfixed(false), isfloating(false), isurgent(false), neverfocus(false),
-      oldstate(false), isfullscreen(false), mon(nullptr) {
+      oldstate(false), isfullscreen(false), protocols(0), wmstate(WithdrawnState), ignoreUnmap(0), mon(nullptr),
+      next(nullptr), prev(nullptr), focus(), focusSeq(0), flood() {
+    flood.tokens = CONFIGURE_BURST;
 }
 
 // Client destructor
 Client::~Client() {
+    releaseTitle(name);
 }
 
 // Layout constructor
@@ -33,8 +42,12 @@ void attachClient(Client* c) {
     if (!c || !c->mon) return;
     
     Monitor* m = c->mon;
-    c->mon->tags[c->mon->selectedTag].clients.insert(
-        c->mon->tags[c->mon->selectedTag].clients.begin(), c);
+    c->prev = nullptr;
+    c->next = m->clients;
+    if (m->clients) {
+        m->clients->prev = c;
+    }
+    m->clients = c;
 }
 
 // Detach client from the client list
@@ -42,28 +55,134 @@ void detachClient(Client* c) {
     if (!c || !c->mon) return;
     
     Monitor* m = c->mon;
-    auto& clients = m->tags[m->selectedTag].clients;
-    auto it = std::find(clients.begin(), clients.end(), c);
-    if (it != clients.end()) {
-        clients.erase(it);
+    if (c->prev) {
+        c->prev->next = c->next;
+    } else if (m->clients == c) {
+        m->clients = c->next;
+    }
+    if (c->next) {
+        c->next->prev = c->prev;
+    }
+    c->next = c->prev = nullptr;
+}
+
+// Each tag of a monitor keeps its clients in a circular, doubly linked
+// list through Client::focus, most recently focused first. A client is on
+// the list of every tag it has, so finding the client to focus after an
+// unmap or a view, and cycling, take a few pointer steps whatever the
+// number of windows.
+static unsigned long focusCount;  // Orders the heads of different tags
+
+static void linkStack(Client*& head, Client* c, int t) {
+    FocusLink& l = c->focus[t];
+
+    if (!head) {
+        l.next = l.prev = c;
+    } else {
+        l.next = head;
+        l.prev = head->focus[t].prev;
+        l.prev->focus[t].next = c;
+        head->focus[t].prev = c;
+    }
+    head = c;
+}
+
+static void unlinkStack(Client*& head, Client* c, int t) {
+    FocusLink& l = c->focus[t];
+
+    if (l.next == c) {
+        head = nullptr;
+    } else {
+        l.prev->focus[t].next = l.next;
+        l.next->focus[t].prev = l.prev;
+        if (head == c) {
+            head = l.next;
+        }
     }
+    l.next = l.prev = nullptr;
 }
 
-// Attach client to the stack
+// Attach client to the front of its tags' focus lists
 void attachStack(Client* c) {
-    // In our C++ implementation, we don't need a separate stack
-    // as we can use the clients vector for both purposes
+    if (!c || !c->mon) return;
+
+    for (int t = 0; t < NUM_TAGS; t++) {
+        if (c->tags & (1u << t)) {
+            linkStack(c->mon->tags[t].focusStack, c, t);
+        }
+    }
 }
 
-// Detach client from the stack
+// Detach client from its tags' focus lists; call before changing its tags
+// or monitor
 void detachStack(Client* c) {
-    // In our C++ implementation, we don't need a separate stack
-    // as we can use the clients vector for both purposes
+    if (!c || !c->mon) return;
+
+    for (int t = 0; t < NUM_TAGS; t++) {
+        if (c->focus[t].next) {
+            unlinkStack(c->mon->tags[t].focusStack, c, t);
+        }
+    }
 }
 
-// Apply rules to a client
-void applyRules(Client* c) {
-    // TODO: Implement rule application
+// Move a client being focused to the front of its tags' focus lists
+void promoteStack(Client* c) {
+    c->focusSeq = ++focusCount;
+    for (int t = 0; t < NUM_TAGS; t++) {
+        Client*& head = c->mon->tags[t].focusStack;
+        if (c->focus[t].next && head != c) {
+            unlinkStack(head, c, t);
+            linkStack(head, c, t);
+        }
+    }
+}
+
+// Most recently focused visible client of a monitor. Every client on a
+// shown tag is visible, so this is the latest of the shown tags' heads.
+Client* recentClient(Monitor* m) {
+    Client* best = nullptr;
+
+    for (int t = 0; t < NUM_TAGS; t++) {
+        Client* c = m->tags[t].focusStack;
+        if ((m->tagset & (1u << t)) && c && (!best || c->focusSeq > best->focusSeq)) {
+            best = c;
+        }
+    }
+    return best;
+}
+
+// The client to cycle to from c on the selected tag (or the first shown
+// one). Forward is the previously focused client, so repeating it flips
+// between two like alt-tab; backward is the least recently focused, so
+// repeating it visits every client in turn.
+Client* cycleStack(Monitor* m, Client* c, int dir) {
+    int t = m->selectedTag;
+    if (!(m->tagset & (1u << t))) {
+        t = __builtin_ctz(m->tagset);
+    }
+
+    Client* head = m->tags[t].focusStack;
+    if (!head) return nullptr;
+    if (!c || c->mon != m || !c->focus[t].next) {
+        c = head;
+        if (dir > 0) return c;
+    }
+    return dir > 0 ? c->focus[t].next : c->focus[t].prev;
+}
+
+// Apply the rules matching a new window, see RULES in config.h
+void applyRules(Client* c, const WindowInfo& info) {
+    WindowManager* wm = g_windowManager;
+    RuleMatch r = matchRules(info.cls, info.instance, info.name);
+    unsigned int tagmask = (1u << NUM_TAGS) - 1;
+
+    if (r.matched) {
+        c->isfloating = r.isfloating;
+        if (r.monitor >= 0 && r.monitor < static_cast<int>(wm->monitors.size())) {
+            c->mon = &wm->monitors[r.monitor];
+        }
+    }
+    c->tags = (r.tags & tagmask) ? (r.tags & tagmask) : c->mon->tagset;
 }
 
 // Apply size hints to a client
@@ -76,19 +195,51 @@ void updateClientList() {
     // TODO: Implement client list update
 }
 
-// Update window title
-void updateTitle(Client* c) {
+// Length of s without a UTF-8 sequence cut short at its end, as when a
+// long title is read only up to the request's length
+static size_t completeUtf8(const unsigned char* s, size_t len) {
+    size_t i = len;
+
+    while (i > 0 && len - i < 3 && (s[i - 1] & 0xC0) == 0x80) {
+        i--;
+    }
+    if (i == 0 || s[i - 1] < 0xC0) return len;
+
+    unsigned char lead = s[i - 1];
+    size_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+    return (len - (i - 1) < need) ? i - 1 : len;
+}
+
+static void applyTitle(Window win, Atom prop, const PropertyReply* reply) {
+    Client* c = g_windowManager->getClientByWindow(win);
     if (!c) return;
-    
-    char name[256] = {0};
-    XTextProperty prop;
-    
-    if (XGetWMName(g_windowManager->display, c->window, &prop) && prop.value && prop.nitems) {
-        strncpy(name, reinterpret_cast<char*>(prop.value), sizeof(name) - 1);
-        XFree(prop.value);
+
+    if (reply && reply->format == 8 && reply->nitems) {
+        const char* text = reinterpret_cast<const char*>(reply->data);
+        size_t len = strnlen(text, reply->nitems);
+        if (prop != XA_WM_NAME) {
+            len = completeUtf8(reply->data, len);
+        }
+        setTitle(c->name, text, len);
+    } else if (prop != XA_WM_NAME) {
+        // No _NET_WM_NAME; fall back to the ICCCM name
+        requestProperty(win, XA_WM_NAME, AnyPropertyType, 64, applyTitle);
+    } else {
+        setTitle(c->name, "broken", 6);
     }
-    
-    c->name = name[0] ? name : "broken";
+}
+
+// Read a title marked stale, preferring UTF-8 _NET_WM_NAME to WM_NAME.
+// The bar calls this for the client it is about to show, so however often
+// a title changes it is read at most once a frame, and only while shown.
+// The reply is applied whenever it arrives; the client may be gone by then.
+void updateTitle(Client* c) {
+    if (!c || !c->titleStale) return;
+
+    c->titleStale = false;
+    titleStats().reads++;
+    requestProperty(c->window, g_windowManager->netatom[NetWMName], AnyPropertyType, 64,
+                    applyTitle);
 }
 
 // Update window type
@@ -98,7 +249,59 @@ void updateWindowType(Client* c) {
 
 // Update WM hints
 void updateWMHints(Client* c) {
-    // TODO: Implement WM hints update
+    if (!c) return;
+
+    requestProperty(c->window, XA_WM_HINTS, XA_WM_HINTS, 9,
+                    [](Window win, Atom, const PropertyReply* reply) {
+        Client* c = g_windowManager->getClientByWindow(win);
+        if (!c || !reply || reply->format != 32 || reply->nitems < 2) return;
+
+        // Format 32 data is an array of longs on the Xlib side and of
+        // CARD32 on the XCB side
+        const unsigned char* d = reply->data;
+        long flags, input;
+#ifdef XCB
+        flags = reinterpret_cast<const uint32_t*>(d)[0];
+        input = reinterpret_cast<const uint32_t*>(d)[1];
+#else
+        flags = reinterpret_cast<const long*>(d)[0];
+        input = reinterpret_cast<const long*>(d)[1];
+#endif
+        c->isurgent = c != g_windowManager->getFocusedClient() && (flags & XUrgencyHint);
+        c->neverfocus = (flags & InputHint) && !input;
+    });
+}
+
+// The bit standing for a WM_PROTOCOLS atom in Client::protocols, 0 for
+// protocols nwm does not use
+unsigned int protocolBit(Atom proto) {
+    const Atom* wmatom = g_windowManager->wmatom;
+
+    if (proto == wmatom[WMDelete]) return 1u << WMDelete;
+    if (proto == wmatom[WMTakeFocus]) return 1u << WMTakeFocus;
+    return 0;
+}
+
+// Reread WM_PROTOCOLS after it changed. Until the reply is in, sendEvent()
+// goes by the old value.
+void updateProtocols(Client* c) {
+    if (!c) return;
+
+    requestProperty(c->window, g_windowManager->wmatom[WMProtocols], XA_ATOM, 16,
+                    [](Window win, Atom, const PropertyReply* reply) {
+        Client* c = g_windowManager->getClientByWindow(win);
+        if (!c) return;
+
+        c->protocols = 0;
+        if (!reply || reply->format != 32) return;
+        for (unsigned long i = 0; i < reply->nitems; i++) {
+#ifdef XCB
+            c->protocols |= protocolBit(reinterpret_cast<const uint32_t*>(reply->data)[i]);
+#else
+            c->protocols |= protocolBit(reinterpret_cast<const long*>(reply->data)[i]);
+#endif
+        }
+    });
 }
 
 // Update size hints
@@ -108,7 +311,13 @@ void updateSizeHints(Client* c) {
 
 // Set client state
 void setClientState(Client* c, long state) {
-    // TODO: Implement client state setting
+    if (!c || c->wmstate == state) return;
+
+    long data[] = { state, None };
+    XChangeProperty(g_windowManager->display, c->window, g_windowManager->wmatom[WMState],
+                    g_windowManager->wmatom[WMState], 32, PropModeReplace,
+                    reinterpret_cast<unsigned char*>(data), 2);
+    c->wmstate = state;
 }
 
 // Set fullscreen state
@@ -116,20 +325,165 @@ void setFullscreen(Client* c, bool fullscreen) {
     // TODO: Implement fullscreen setting
 }
 
-// Send event to client
+// Send a WM_PROTOCOLS message, if the client takes it. WM_PROTOCOLS is
+// read with the rest at manage time and reread when it changes, so this
+// never waits on the server.
 int sendEvent(Client* c, Atom proto) {
-    // TODO: Implement event sending
-    return 0;
+    if (!c) return 0;
+
+    WindowManager* wm = g_windowManager;
+    int exists = (c->protocols & protocolBit(proto)) != 0;
+
+    if (exists) {
+        XEvent ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.type = ClientMessage;
+        ev.xclient.window = c->window;
+        ev.xclient.message_type = wm->wmatom[WMProtocols];
+        ev.xclient.format = 32;
+        ev.xclient.data.l[0] = proto;
+        ev.xclient.data.l[1] = CurrentTime;
+        XSendEvent(wm->display, c->window, False, NoEventMask, &ev);
+    }
+    return exists;
 }
 
-// Resize client
+// Resize client, honouring size hints
 void resize(Client* c, int x, int y, int w, int h, bool interact) {
-    // TODO: Implement client resizing
+    if (!c) return;
+
+    applySizeHints(c, &x, &y, &w, &h, interact);
+    resizeClient(c, MAX(x, -0x7fff), MAX(y, -0x7fff), MAX(w, 1), MAX(h, 1));
 }
 
-// Resize client
+// Resize client. Only the fields that differ from the geometry last sent
+// to the server go out, in a single XConfigureWindow; an unchanged
+// geometry sends nothing.
 void resizeClient(Client* c, int x, int y, int w, int h) {
-    // TODO: Implement client resizing
+    if (!c) return;
+
+    XWindowChanges wc;
+    unsigned int mask = 0;
+
+    c->oldx = c->x; c->x = x;
+    c->oldy = c->y; c->y = y;
+    c->oldwidth = c->width; c->width = w;
+    c->oldheight = c->height; c->height = h;
+
+    if (x != c->srvx) { wc.x = x; mask |= CWX; }
+    if (y != c->srvy) { wc.y = y; mask |= CWY; }
+    if (w != c->srvwidth) { wc.width = w; mask |= CWWidth; }
+    if (h != c->srvheight) { wc.height = h; mask |= CWHeight; }
+    if (c->bw != c->srvbw) { wc.border_width = c->bw; mask |= CWBorderWidth; }
+
+    if (!mask) {
+        g_windowManager->configureStats.avoided++;
+        return;
+    }
+
+    XConfigureWindow(g_windowManager->display, c->window, mask, &wc);
+    c->srvx = x;
+    c->srvy = y;
+    c->srvwidth = w;
+    c->srvheight = h;
+    c->srvbw = c->bw;
+    g_windowManager->configureStats.sent++;
+}
+
+// Move the window without changing the client's geometry, as when
+// parking it offscreen. Like resizeClient(), sends nothing if the server
+// already has it there.
+void moveClientWindow(Client* c, int x, int y) {
+    XWindowChanges wc;
+    unsigned int mask = 0;
+
+    if (x != c->srvx) { wc.x = x; mask |= CWX; }
+    if (y != c->srvy) { wc.y = y; mask |= CWY; }
+    if (!mask) {
+        g_windowManager->configureStats.avoided++;
+        return;
+    }
+
+    XConfigureWindow(g_windowManager->display, c->window, mask, &wc);
+    c->srvx = x;
+    c->srvy = y;
+    g_windowManager->configureStats.sent++;
+}
+
+// Tell the client its geometry with a synthetic ConfigureNotify, as ICCCM
+// asks when a request is refused or changes nothing
+void sendConfigure(Client* c) {
+    XConfigureEvent ce;
+
+    ce.type = ConfigureNotify;
+    ce.display = g_windowManager->display;
+    ce.event = c->window;
+    ce.window = c->window;
+    ce.x = c->x;
+    ce.y = c->y;
+    ce.width = c->width;
+    ce.height = c->height;
+    ce.border_width = c->bw;
+    ce.above = None;
+    ce.override_redirect = False;
+    XSendEvent(g_windowManager->display, c->window, False, StructureNotifyMask,
+               reinterpret_cast<XEvent*>(&ce));
+}
+
+// Clients owing a ConfigureRequest reply, in request order
+static std::vector<Window> configureQueue;
+
+// Answer a ConfigureRequest in flushConfigures(). Requests made before
+// then share the one reply.
+void queueConfigure(Client* c) {
+    if (c->flood.pending) return;
+    c->flood.pending = true;
+    configureQueue.push_back(c->window);
+}
+
+// Reply to every queued ConfigureRequest whose client is within its rate:
+// a visible floating client gets the geometry it asked for, anyone else a
+// synthetic notify of the geometry it has. The rest wait for their bucket
+// to refill; the return value is how long that takes in ms, or -1 if
+// nothing is waiting.
+int flushConfigures() {
+    WindowManager* wm = g_windowManager;
+    double now = monotonicMs();
+    double wait = -1;
+    size_t kept = 0;
+
+    for (Window w : configureQueue) {
+        Client* c = wm->getClientByWindow(w);
+        if (!c || !c->flood.pending) continue;
+
+        ConfigureFlood& f = c->flood;
+        f.tokens = MIN(static_cast<double>(CONFIGURE_BURST),
+                       f.tokens + (now - f.stamp) * CONFIGURE_RATE / 1000.0);
+        f.stamp = now;
+        if (f.tokens < 1) {
+            double ms = (1 - f.tokens) * 1000.0 / CONFIGURE_RATE;
+            wait = (wait < 0) ? ms : MIN(wait, ms);
+            f.deferred++;
+            wm->configureStats.deferred++;
+            configureQueue[kept++] = w;
+            continue;
+        }
+
+        f.tokens -= 1;
+        f.pending = false;
+        f.replies++;
+        wm->configureStats.replies++;
+        bool floating = c->isfloating || c->mon->tag().layout == LayoutType::FLOATING;
+        if (floating && ISVISIBLE(c) &&
+            (c->x != c->srvx || c->y != c->srvy || c->width != c->srvwidth ||
+             c->height != c->srvheight || c->bw != c->srvbw)) {
+            resizeClient(c, c->x, c->y, c->width, c->height);
+        } else {
+            sendConfigure(c);
+        }
+    }
+    configureQueue.resize(kept);
+    return (wait < 0) ? -1 : static_cast<int>(std::ceil(wait));
 }
 
 // Resize with mouse
@@ -154,6 +508,8 @@ void pop(Client* c) {
 
 // Get next tiled client
 Client* nexttiled(Client* c) {
-    // TODO: Implement next tiled client finding
-    return nullptr;
+    while (c && (c->isfloating || c->isfullscreen || !ISVISIBLE(c))) {
+        c = c->next;
+    }
+    return c;
 }
@@ -7,18 +7,27 @@ void attachClient(Client* c);
 void detachClient(Client* c);
 void attachStack(Client* c);
 void detachStack(Client* c);
-void applyRules(Client* c);
+void promoteStack(Client* c);
+Client* recentClient(Monitor* m);
+Client* cycleStack(Monitor* m, Client* c, int dir);
+void applyRules(Client* c, const WindowInfo& info);
 void applySizeHints(Client* c, int* x, int* y, int* w, int* h, bool interact);
 void updateClientList();
 void updateTitle(Client* c);
 void updateWindowType(Client* c);
 void updateWMHints(Client* c);
+unsigned int protocolBit(Atom proto);
+void updateProtocols(Client* c);
 void updateSizeHints(Client* c);
 void setClientState(Client* c, long state);
 void setFullscreen(Client* c, bool fullscreen);
 int sendEvent(Client* c, Atom proto);
 void resize(Client* c, int x, int y, int w, int h, bool interact);
 void resizeClient(Client* c, int x, int y, int w, int h);
+void moveClientWindow(Client* c, int x, int y);
+void sendConfigure(Client* c);
+void queueConfigure(Client* c);
+int flushConfigures();
 void resizemouse(Client* c);
 void movemouse(Client* c);
 void zoom(Client* c);
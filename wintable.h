@@ -0,0 +1,98 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Flat open-addressing hash table keyed by Window.
+// Keys and values live side by side in one array, probed linearly, so a
+// lookup touches one or two cache lines. Window 0 (None) marks an empty
+// slot and is never a valid key. Erase uses backward-shift deletion, so
+// there are no tombstones and probe lengths stay short under churn.
+template <typename V>
+class WindowTable {
+public:
+    WindowTable() : count(0), mask(0), shift(0) { rehash(16); }
+
+    V find(Window key) const {
+        for (size_t i = slot(key);; i = (i + 1) & mask) {
+            if (entries[i].key == key) return entries[i].value;
+            if (entries[i].key == None) return V();
+        }
+    }
+
+    // Insert or overwrite the value stored for key
+    void insert(Window key, V value) {
+        if ((count + 1) * 2 > entries.size()) {
+            rehash(entries.size() * 2);
+        }
+
+        size_t i = slot(key);
+        while (entries[i].key != None && entries[i].key != key) {
+            i = (i + 1) & mask;
+        }
+        if (entries[i].key == None) {
+            count++;
+        }
+        entries[i].key = key;
+        entries[i].value = value;
+    }
+
+    bool erase(Window key) {
+        size_t i = slot(key);
+        while (entries[i].key != key) {
+            if (entries[i].key == None) return false;
+            i = (i + 1) & mask;
+        }
+
+        // Shift later members of the probe run back into the hole
+        for (size_t j = (i + 1) & mask; entries[j].key != None; j = (j + 1) & mask) {
+            size_t home = slot(entries[j].key);
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                entries[i] = entries[j];
+                i = j;
+            }
+        }
+        entries[i].key = None;
+        entries[i].value = V();
+        count--;
+        return true;
+    }
+
+    size_t size() const { return count; }
+
+private:
+    struct Entry {
+        Window key;
+        V value;
+    };
+
+    // Fibonacci hashing; XIDs are sequential per client so the low bits
+    // alone would cluster badly
+    size_t slot(Window key) const {
+        return static_cast<size_t>((static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> shift) & mask;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<Entry> old;
+        old.swap(entries);
+        entries.assign(capacity, Entry{None, V()});
+        mask = capacity - 1;
+        shift = 64;
+        for (size_t c = capacity; c > 1; c >>= 1) {
+            shift--;
+        }
+        count = 0;
+        for (const Entry& e : old) {
+            if (e.key != None) {
+                insert(e.key, e.value);
+            }
+        }
+    }
+
+    std::vector<Entry> entries;
+    size_t count;
+    size_t mask;
+    unsigned int shift;
+};
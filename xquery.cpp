@@ -0,0 +1,389 @@
+#include "xquery.h"
+#include "nwm.h"
+#include "profile.h"
+#include "window.h"
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <cstring>
+#ifdef XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+#include <cstdlib>
+#include <deque>
+#endif
+
+// Longest WM_NAME and WM_CLASS read at manage time, in 32-bit units
+static constexpr uint32_t NAME_LENGTH = 64;
+static constexpr uint32_t CLASS_LENGTH = 64;
+static constexpr uint32_t PROTOCOLS_LENGTH = 16;
+
+static void resetInfo(WindowInfo& info, Window win) {
+    info.window = win;
+    info.valid = false;
+    memset(&info.attrs, 0, sizeof(info.attrs));
+    info.hintFlags = 0;
+    info.input = true;
+    info.name.clear();
+    info.instance.clear();
+    info.cls.clear();
+    info.transientFor = None;
+    info.state = -1;
+    info.protocols = 0;
+}
+
+#ifdef XCB
+
+// Split WM_CLASS, "instance\0class\0", into its two strings
+static void parseClass(WindowInfo& info, const char* data, size_t len) {
+    size_t n = strnlen(data, len);
+    info.instance.assign(data, n);
+    if (n < len) {
+        info.cls.assign(data + n + 1, strnlen(data + n + 1, len - n - 1));
+    }
+}
+
+// Cookies for one window's requests
+struct WindowCookies {
+    xcb_get_window_attributes_cookie_t attrs;
+    xcb_get_geometry_cookie_t geom;
+    xcb_get_property_cookie_t hints;
+    xcb_get_property_cookie_t name;
+    xcb_get_property_cookie_t cls;
+    xcb_get_property_cookie_t transient;
+    xcb_get_property_cookie_t protocols;
+    xcb_get_property_cookie_t state;  // Sent last, so its reply is the last to arrive
+};
+
+static void sendRequests(xcb_connection_t* conn, xcb_window_t w, WindowCookies& cookies) {
+    xcb_atom_t wmState = g_windowManager->wmatom[WMState];
+    xcb_atom_t wmProtocols = g_windowManager->wmatom[WMProtocols];
+
+    cookies.attrs = xcb_get_window_attributes(conn, w);
+    cookies.geom = xcb_get_geometry(conn, w);
+    cookies.hints = xcb_get_property(conn, 0, w, XCB_ATOM_WM_HINTS, XCB_ATOM_WM_HINTS, 0, 9);
+    cookies.name = xcb_get_property(conn, 0, w, XCB_ATOM_WM_NAME,
+                                    XCB_GET_PROPERTY_TYPE_ANY, 0, NAME_LENGTH);
+    cookies.cls = xcb_get_property(conn, 0, w, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, CLASS_LENGTH);
+    cookies.transient = xcb_get_property(conn, 0, w, XCB_ATOM_WM_TRANSIENT_FOR,
+                                         XCB_ATOM_WINDOW, 0, 1);
+    cookies.protocols = xcb_get_property(conn, 0, w, wmProtocols, XCB_ATOM_ATOM, 0,
+                                         PROTOCOLS_LENGTH);
+    cookies.state = xcb_get_property(conn, 0, w, wmState, wmState, 0, 2);
+}
+
+// Fill info from the replies to sendRequests(). The WM_STATE reply is
+// passed in, since it may already have been taken off the connection;
+// errors just leave a field unset.
+static void collectInfo(xcb_connection_t* conn, const WindowCookies& cookies,
+                        xcb_get_property_reply_t* state, WindowInfo& info) {
+    xcb_get_window_attributes_reply_t* wa =
+        xcb_get_window_attributes_reply(conn, cookies.attrs, nullptr);
+    xcb_get_geometry_reply_t* geom = xcb_get_geometry_reply(conn, cookies.geom, nullptr);
+    if (wa && geom) {
+        info.valid = true;
+        info.attrs.x = geom->x;
+        info.attrs.y = geom->y;
+        info.attrs.width = geom->width;
+        info.attrs.height = geom->height;
+        info.attrs.border_width = geom->border_width;
+        info.attrs.override_redirect = wa->override_redirect;
+        info.attrs.map_state = wa->map_state;
+    }
+    free(wa);
+    free(geom);
+
+    xcb_get_property_reply_t* r = xcb_get_property_reply(conn, cookies.hints, nullptr);
+    if (r && xcb_get_property_value_length(r) >= 8) {
+        const uint32_t* v = static_cast<const uint32_t*>(xcb_get_property_value(r));
+        info.hintFlags = v[0];
+        info.input = v[1];
+    }
+    free(r);
+
+    r = xcb_get_property_reply(conn, cookies.name, nullptr);
+    if (r && xcb_get_property_value_length(r) > 0) {
+        info.name.assign(static_cast<const char*>(xcb_get_property_value(r)),
+                         xcb_get_property_value_length(r));
+    }
+    free(r);
+
+    r = xcb_get_property_reply(conn, cookies.cls, nullptr);
+    if (r && xcb_get_property_value_length(r) > 0) {
+        parseClass(info, static_cast<const char*>(xcb_get_property_value(r)),
+                   xcb_get_property_value_length(r));
+    }
+    free(r);
+
+    r = xcb_get_property_reply(conn, cookies.transient, nullptr);
+    if (r && xcb_get_property_value_length(r) >= 4) {
+        info.transientFor = *static_cast<const xcb_window_t*>(xcb_get_property_value(r));
+    }
+    free(r);
+
+    r = xcb_get_property_reply(conn, cookies.protocols, nullptr);
+    if (r && r->format == 32) {
+        const xcb_atom_t* atoms = static_cast<const xcb_atom_t*>(xcb_get_property_value(r));
+        for (int k = 0; k < xcb_get_property_value_length(r) / 4; k++) {
+            info.protocols |= protocolBit(atoms[k]);
+        }
+    }
+    free(r);
+
+    if (state && xcb_get_property_value_length(state) >= 4) {
+        info.state = *static_cast<const uint32_t*>(xcb_get_property_value(state));
+    }
+    free(state);
+}
+
+void queryWindows(const Window* wins, unsigned int n, std::vector<WindowInfo>& out) {
+    Display* dpy = g_windowManager->display;
+    xcb_connection_t* conn = XGetXCBConnection(dpy);
+    std::vector<WindowCookies> cookies(n);
+
+    out.resize(n);
+
+    // Anything Xlib still buffers (a server grab, say) must go out first
+    XFlush(dpy);
+
+    // Send every request before waiting for any reply
+    for (unsigned int i = 0; i < n; i++) {
+        sendRequests(conn, wins[i], cookies[i]);
+    }
+
+    // Collect the replies in order. Only the first wait is a real round
+    // trip, the rest have arrived with it.
+    if (n) {
+        countRoundTrips();
+    }
+    for (unsigned int i = 0; i < n; i++) {
+        resetInfo(out[i], wins[i]);
+        collectInfo(conn, cookies[i], xcb_get_property_reply(conn, cookies[i].state, nullptr),
+                    out[i]);
+    }
+}
+
+// Asynchronous property request waiting for its reply
+struct PendingProperty {
+    xcb_get_property_cookie_t cookie;
+    Window window;
+    Atom prop;
+    PropertyCallback callback;
+};
+
+// Window query waiting for its replies
+struct PendingWindow {
+    WindowCookies cookies;
+    Window window;
+    WindowCallback callback;
+};
+
+// Replies come back in request order, so a FIFO is enough
+static std::deque<PendingProperty> pending;
+static std::deque<PendingWindow> pendingWindows;
+
+void requestProperty(Window win, Atom prop, Atom type, long length, PropertyCallback cb) {
+    xcb_connection_t* conn = XGetXCBConnection(g_windowManager->display);
+    PendingProperty p;
+
+    p.cookie = xcb_get_property(conn, 0, win, prop, type, 0, length);
+    p.window = win;
+    p.prop = prop;
+    p.callback = cb;
+    pending.push_back(p);
+}
+
+void requestWindow(Window win, WindowCallback cb) {
+    xcb_connection_t* conn = XGetXCBConnection(g_windowManager->display);
+    PendingWindow p;
+
+    sendRequests(conn, win, p.cookies);
+    p.window = win;
+    p.callback = cb;
+    pendingWindows.push_back(p);
+}
+
+// Deliver the window queries whose WM_STATE reply, their last, is in
+static unsigned int pollWindows(xcb_connection_t* conn) {
+    unsigned int delivered = 0;
+    WindowInfo info;
+
+    while (!pendingWindows.empty()) {
+        PendingWindow p = pendingWindows.front();
+        void* raw = nullptr;
+        xcb_generic_error_t* err = nullptr;
+
+        if (!xcb_poll_for_reply(conn, p.cookies.state.sequence, &raw, &err)) {
+            break;
+        }
+        pendingWindows.pop_front();
+        free(err);
+
+        // Every earlier reply is in as well, so none of this waits
+        resetInfo(info, p.window);
+        collectInfo(conn, p.cookies, static_cast<xcb_get_property_reply_t*>(raw), info);
+        p.callback(info);
+        delivered++;
+    }
+    return delivered;
+}
+
+unsigned int pollReplies() {
+    xcb_connection_t* conn = XGetXCBConnection(g_windowManager->display);
+    unsigned int delivered = 0;
+
+    // Make sure the requests are on the wire, or their replies never come
+    if (!pending.empty() || !pendingWindows.empty()) {
+        xcb_flush(conn);
+    }
+    delivered += pollWindows(conn);
+
+    while (!pending.empty()) {
+        PendingProperty p = pending.front();
+        void* raw = nullptr;
+        xcb_generic_error_t* err = nullptr;
+
+        if (!xcb_poll_for_reply(conn, p.cookie.sequence, &raw, &err)) {
+            break;  // Not here yet; later replies cannot be either
+        }
+        pending.pop_front();
+
+        xcb_get_property_reply_t* r = static_cast<xcb_get_property_reply_t*>(raw);
+        if (r && r->type != XCB_NONE) {
+            PropertyReply reply;
+            reply.type = r->type;
+            reply.format = r->format;
+            reply.nitems = xcb_get_property_value_length(r) / MAX(r->format / 8, 1);
+            reply.data = static_cast<const unsigned char*>(xcb_get_property_value(r));
+            p.callback(p.window, p.prop, &reply);
+        } else {
+            p.callback(p.window, p.prop, nullptr);
+        }
+        free(r);
+        free(err);
+        delivered++;
+    }
+
+    return delivered;
+}
+
+size_t pendingReplies() {
+    return pending.size() + pendingWindows.size();
+}
+
+#else
+
+void queryWindows(const Window* wins, unsigned int n, std::vector<WindowInfo>& out) {
+    Display* dpy = g_windowManager->display;
+    Atom wmState = g_windowManager->wmatom[WMState];
+
+    out.resize(n);
+
+    for (unsigned int i = 0; i < n; i++) {
+        WindowInfo& info = out[i];
+        resetInfo(info, wins[i]);
+
+        // GetWindowAttributes and GetGeometry, then six property reads
+        countRoundTrips(2);
+        if (!XGetWindowAttributes(dpy, wins[i], &info.attrs)) {
+            continue;
+        }
+        info.valid = true;
+        countRoundTrips(6);
+
+        XWMHints* wmh = XGetWMHints(dpy, wins[i]);
+        if (wmh) {
+            info.hintFlags = wmh->flags;
+            info.input = wmh->input;
+            XFree(wmh);
+        }
+
+        XTextProperty prop;
+        if (XGetWMName(dpy, wins[i], &prop) && prop.value) {
+            if (prop.nitems) {
+                info.name.assign(reinterpret_cast<char*>(prop.value),
+                                 MIN(prop.nitems, NAME_LENGTH * 4));
+            }
+            XFree(prop.value);
+        }
+
+        XClassHint ch = { nullptr, nullptr };
+        if (XGetClassHint(dpy, wins[i], &ch)) {
+            info.instance = ch.res_name ? ch.res_name : "";
+            info.cls = ch.res_class ? ch.res_class : "";
+            if (ch.res_name) XFree(ch.res_name);
+            if (ch.res_class) XFree(ch.res_class);
+        }
+
+        Window trans = None;
+        if (XGetTransientForHint(dpy, wins[i], &trans)) {
+            info.transientFor = trans;
+        }
+
+        Atom* protocols;
+        int nprotocols;
+        if (XGetWMProtocols(dpy, wins[i], &protocols, &nprotocols)) {
+            for (int k = 0; k < nprotocols; k++) {
+                info.protocols |= protocolBit(protocols[k]);
+            }
+            XFree(protocols);
+        }
+
+        Atom type;
+        int format;
+        unsigned long nitems, after;
+        unsigned char* data = nullptr;
+        if (XGetWindowProperty(dpy, wins[i], wmState, 0L, 2L, False, wmState,
+                               &type, &format, &nitems, &after, &data) == Success) {
+            if (data && nitems) {
+                info.state = *reinterpret_cast<long*>(data);
+            }
+            if (data) {
+                XFree(data);
+            }
+        }
+    }
+}
+
+void requestWindow(Window win, WindowCallback cb) {
+    std::vector<WindowInfo> info;
+
+    queryWindows(&win, 1, info);
+    cb(info[0]);
+}
+
+void requestProperty(Window win, Atom prop, Atom type, long length, PropertyCallback cb) {
+    Atom actualType;
+    int format;
+    unsigned long nitems, after;
+    unsigned char* data = nullptr;
+
+    countRoundTrips();
+    if (XGetWindowProperty(g_windowManager->display, win, prop, 0L, length, False, type,
+                           &actualType, &format, &nitems, &after, &data) == Success &&
+        actualType != None) {
+        PropertyReply reply;
+        reply.type = actualType;
+        reply.format = format;
+        reply.nitems = nitems;
+        reply.data = data;
+        cb(win, prop, &reply);
+    } else {
+        cb(win, prop, nullptr);
+    }
+
+    if (data) {
+        XFree(data);
+    }
+}
+
+unsigned int pollReplies() {
+    return 0;
+}
+
+size_t pendingReplies() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "nwm.h"
+
+// Everything manageClient() needs to know about a window, fetched in one
+// pipelined pass
+struct WindowInfo {
+    Window window;
+    bool valid;               // Window exists and its attributes were read
+    XWindowAttributes attrs;  // Geometry, border, override_redirect, map_state
+    long hintFlags;           // WM_HINTS flags, 0 if unset
+    bool input;               // WM_HINTS input field
+    std::string name;         // WM_NAME
+    std::string instance;     // WM_CLASS res_name
+    std::string cls;          // WM_CLASS res_class
+    Window transientFor;      // WM_TRANSIENT_FOR, None if unset
+    long state;               // WM_STATE, -1 if unset
+    unsigned int protocols;   // WM_PROTOCOLS, see protocolBit()
+};
+
+// Query attributes, WM_HINTS, WM_NAME, WM_CLASS, WM_TRANSIENT_FOR,
+// WM_PROTOCOLS and WM_STATE for n windows. With XCB every request is sent
+// before the first reply is read; the Xlib fallback costs a round trip per
+// property.
+void queryWindows(const Window* wins, unsigned int n, std::vector<WindowInfo>& out);
+
+// Called once everything queryWindows() reads about a window has arrived
+typedef void (*WindowCallback)(const WindowInfo& info);
+
+// The same queries for one window without waiting for them. With XCB the
+// info is delivered from pollReplies() once its last reply has been read;
+// the Xlib adapter queries on the spot and calls back before returning.
+void requestWindow(Window win, WindowCallback cb);
+
+// Property value handed to a PropertyCallback; data is only valid for the
+// duration of the call
+struct PropertyReply {
+    Atom type;
+    int format;
+    unsigned long nitems;
+    const unsigned char* data;
+};
+
+// Called when a requested property arrives; reply is null if the window
+// is gone or the property is unset
+typedef void (*PropertyCallback)(Window win, Atom prop, const PropertyReply* reply);
+
+// Ask for a property without waiting for it. With XCB the reply is
+// delivered from pollReplies() once it has been read; the Xlib adapter
+// reads it on the spot and calls back before returning.
+void requestProperty(Window win, Atom prop, Atom type, long length, PropertyCallback cb);
+
+// Deliver every reply that has already arrived, in request order, without
+// blocking. Returns the number of callbacks run.
+unsigned int pollReplies();
+
+// Requests (property reads and window queries) still waiting for replies
+size_t pendingReplies();